@@ -0,0 +1,281 @@
+#include "Calibration.h"
+#include "Encoder.h"
+#include "VelocityControl.h"
+#include "TOFSensors.h"
+#include "Movement.h"
+#include "TraceRecorder.h"
+#include <Arduino.h>
+#include <Preferences.h>
+#include <string.h>
+
+// NVS namespace and key
+const char* CALIBRATION_STORE_NAMESPACE = "calib";
+const char* CALIBRATION_STORE_KEY = "geometry";
+
+Preferences calibrationPrefs;
+
+// Effective geometry in use; read by the control loop on the other core
+volatile float wheelDiameter = DEFAULT_WHEEL_DIAM_MM;
+volatile float wheelBase = DEFAULT_WHEEL_BASE_MM;
+volatile float countsPerMM = COUNTS_PER_REV / (PI * DEFAULT_WHEEL_DIAM_MM);
+
+// Saved in trace checkpoints
+static TraceState wheelDiameterState("calibration.wheelDiameter", (void*)&wheelDiameter, sizeof(wheelDiameter));
+static TraceState wheelBaseState("calibration.wheelBase", (void*)&wheelBase, sizeof(wheelBase));
+static TraceState countsPerMMState("calibration.countsPerMM", (void*)&countsPerMM, sizeof(countsPerMM));
+
+static void applyCalibration(float diameter_mm, float base_mm) {
+  wheelDiameter = diameter_mm;
+  wheelBase = base_mm;
+  countsPerMM = COUNTS_PER_REV / (PI * diameter_mm);
+  
+  Serial.print("Wheel diameter: ");
+  Serial.print(diameter_mm, 2);
+  Serial.print("mm | wheel base: ");
+  Serial.print(base_mm, 2);
+  Serial.println("mm");
+}
+
+// Is a measured value close enough to the nominal one to be believed?
+static bool plausible(float value, float nominal) {
+  return fabs(value / nominal - 1) <= CALIBRATION_MAX_ERROR;
+}
+
+bool initCalibration() {
+  StoredCalibration stored;
+  calibrationPrefs.begin(CALIBRATION_STORE_NAMESPACE, true);
+  size_t length = calibrationPrefs.getBytesLength(CALIBRATION_STORE_KEY);
+  bool found = length == sizeof(StoredCalibration) &&
+               calibrationPrefs.getBytes(CALIBRATION_STORE_KEY, &stored, sizeof(stored)) == sizeof(stored);
+  calibrationPrefs.end();
+  traceBytes(&stored, sizeof(stored), found);
+  
+  if (found && (stored.magic != CALIBRATION_STORE_MAGIC || stored.version != CALIBRATION_STORE_VERSION ||
+                !plausible(stored.wheelDiameter_mm, WHEEL_DIAM) || !plausible(stored.wheelBase_mm, WHEEL_BASE))) {
+    Serial.println("Stored calibration invalid - ignoring it");
+    found = false;
+  }
+  
+  if (!found) {
+    Serial.println("No stored calibration - using defaults");
+    applyCalibration(DEFAULT_WHEEL_DIAM_MM, DEFAULT_WHEEL_BASE_MM);
+    return false;
+  }
+  
+  applyCalibration(stored.wheelDiameter_mm, stored.wheelBase_mm);
+  return true;
+}
+
+static bool saveCalibration() {
+  StoredCalibration stored;
+  memset(&stored, 0, sizeof(stored));
+  stored.magic = CALIBRATION_STORE_MAGIC;
+  stored.version = CALIBRATION_STORE_VERSION;
+  stored.wheelDiameter_mm = wheelDiameter;
+  stored.wheelBase_mm = wheelBase;
+  
+  calibrationPrefs.begin(CALIBRATION_STORE_NAMESPACE, false);
+  bool ok = calibrationPrefs.putBytes(CALIBRATION_STORE_KEY, &stored, sizeof(stored)) == sizeof(stored);
+  calibrationPrefs.end();
+  
+  if (!ok) {
+    Serial.println("Failed to save calibration");
+  }
+  return ok;
+}
+
+void clearCalibration() {
+  calibrationPrefs.begin(CALIBRATION_STORE_NAMESPACE, false);
+  calibrationPrefs.remove(CALIBRATION_STORE_KEY);
+  calibrationPrefs.end();
+  
+  Serial.println("Stored calibration cleared");
+  applyCalibration(DEFAULT_WHEEL_DIAM_MM, DEFAULT_WHEEL_BASE_MM);
+}
+
+float getWheelDiameter() {
+  return wheelDiameter;
+}
+
+float getWheelBase() {
+  return wheelBase;
+}
+
+float getCountsPerMM() {
+  return countsPerMM;
+}
+
+// ================== Calibration Maneuvers ==================
+// The maneuvers run on raw encoder counts only, so they do not depend on
+// the values being measured beyond the speed units
+
+// Stop and let the robot come to rest before measuring
+static void settle() {
+  stopMoving();
+  delay(CALIBRATION_SETTLE_MS);
+}
+
+// Speed that ramps up from and down to a stop with DRIVE_ACCEL_MM_S2, so
+// short moves do not overshoot
+static float rampSpeed(long done, long remaining) {
+  float distance_mm = ((done < remaining) ? done : remaining) / getCountsPerMM();
+  if (distance_mm < 0) distance_mm = 0;
+  return constrain(sqrt(2 * DRIVE_ACCEL_MM_S2 * distance_mm), PROFILE_FINAL_SPEED_MM_S, CALIBRATION_SPEED_MM_S);
+}
+
+// Drive both wheels the same signed number of counts: a straight line
+// whatever the wheel diameter. Returns the wheel travel in counts
+static float driveCounts(long counts) {
+  long startLeft, startRight;
+  getEncoderCounts(startLeft, startRight);
+  int direction = (counts > 0) ? 1 : -1;
+  long left = startLeft, right = startRight;
+  long remaining;
+  
+  while ((remaining = direction * counts - direction * ((left - startLeft) + (right - startRight)) / 2) > 0) {
+    float speed = rampSpeed(direction * counts - remaining, remaining);
+    float correction = CALIBRATION_STRAIGHT_GAIN * ((left - startLeft) - (right - startRight)) / getCountsPerMM();
+    setWheelVelocities(direction * speed - correction, direction * speed + correction);
+    delay(DRIVE_TICK_MS);
+    getEncoderCounts(left, right);
+  }
+  
+  settle();
+  getEncoderCounts(left, right);
+  return ((left - startLeft) + (right - startRight)) / 2.0;
+}
+
+// Pivot until each wheel has traveled the given signed counts, positive
+// counter-clockwise. Returns the wheel travel in counts
+static float spinCounts(long counts) {
+  long startLeft, startRight;
+  getEncoderCounts(startLeft, startRight);
+  int direction = (counts > 0) ? 1 : -1;
+  long left = startLeft, right = startRight;
+  long remaining;
+  
+  while ((remaining = direction * counts - direction * ((right - startRight) - (left - startLeft)) / 2) > 0) {
+    float speed = rampSpeed(direction * counts - remaining, remaining);
+    setWheelVelocities(-direction * speed, direction * speed);
+    delay(DRIVE_TICK_MS);
+    getEncoderCounts(left, right);
+  }
+  
+  settle();
+  getEncoderCounts(left, right);
+  return ((right - startRight) - (left - startLeft)) / 2.0;
+}
+
+// Pivot by a signed angle (counter-clockwise positive) with the current
+// wheel base.
+// Returns the wheel travel in counts
+static float spinAngle(float angle) {
+  return spinCounts(lround(angle * wheelBase / 2 * getCountsPerMM()));
+}
+
+// Average ToF reading while standing still; side is -1 for left, 0 for
+// center
+static float averageReading(int side) {
+  long sum = 0;
+  for (int i = 0; i < CALIBRATION_SAMPLES; i++) {
+    readTOF();
+    sum += (side < 0) ? getLeftDistance() : getCenterDistance();
+  }
+  return (float)sum / CALIBRATION_SAMPLES;
+}
+
+// Heading off the wall on the left (counter-clockwise positive), from how
+// much closer the robot gets while driving straight, forward or backward
+// for a negative distance; drives back after. Returns false if there is
+// no wall on the left
+static bool measureHeadingOnLeftWall(float& heading, float distance_mm) {
+  long counts = lround(distance_mm * getCountsPerMM());
+  float startReading = averageReading(-1);
+  float traveled = driveCounts(counts) / getCountsPerMM();
+  float endReading = averageReading(-1);
+  driveCounts(-counts);
+  
+  if (startReading > OPENING_THRESHOLD || endReading > OPENING_THRESHOLD) {
+    Serial.println("Calibration: no wall on the left");
+    return false;
+  }
+  heading = atan((startReading - endReading) / traveled);
+  return true;
+}
+
+// Pivot half a turn, then turn square to the wall on the left on short
+// drives: a wrong wheel base leaves the robot far enough off the wall to
+// hit it. Adds the wheel travel of all pivots to travel (counts)
+static bool halfTurn(float& travel, float drive_mm) {
+  travel += spinAngle(PI);
+  
+  for (int i = 0; i < CALIBRATION_STRAIGHTEN_TRIES; i++) {
+    float heading;
+    if (!measureHeadingOnLeftWall(heading, drive_mm)) return false;
+    if (fabs(heading) < CALIBRATION_STRAIGHT_HEADING) return true;
+    travel += spinAngle(-heading);
+  }
+  Serial.println("Calibration: cannot turn square to the wall");
+  return false;
+}
+
+static bool measureCalibration() {
+  // Wheel base: a full turn on the encoders, checked against the west wall
+  float headingBefore, headingAfter;
+  if (!measureHeadingOnLeftWall(headingBefore, CALIBRATION_DRIVE_MM)) return false;
+  
+  // Facing the south wall the east wall is on the left; back away from it
+  float spinTravel = 0;
+  if (!halfTurn(spinTravel, -CALIBRATION_COARSE_DRIVE_MM)) return false;
+  
+  // Wheel diameter: back away from the south wall by a known wheel travel
+  // and return. Driving along the beam, the reading changes by the
+  // distance driven whatever the heading
+  long counts = lround(CALIBRATION_DRIVE_MM * getCountsPerMM());
+  float startReading = averageReading(0);
+  float travel = -driveCounts(-counts);
+  float farReading = averageReading(0);
+  travel += driveCounts(counts);
+  float endReading = averageReading(0);
+  if (startReading > FRONT_WALL_THRESHOLD) {
+    Serial.println("Calibration: no wall behind the start cell");
+    return false;
+  }
+  
+  if (!halfTurn(spinTravel, CALIBRATION_COARSE_DRIVE_MM)) return false;
+  if (!measureHeadingOnLeftWall(headingAfter, CALIBRATION_DRIVE_MM)) return false;
+  
+  // Circumference = measured distance per revolution of wheel travel
+  float measuredDiameter = (2 * farReading - startReading - endReading) * COUNTS_PER_REV / (PI * travel);
+  
+  // The wheel travel is what the encoders saw; the turn is one revolution
+  // plus the change of the heading on the wall
+  float turned = 2 * PI + headingAfter - headingBefore;
+  float measuredBase = 2 * spinTravel / getCountsPerMM() / turned * measuredDiameter / wheelDiameter;
+  Serial.print("Calibration: turned ");
+  Serial.print(turned * 180 / PI, 2);
+  Serial.println(" degrees");
+  
+  if (!plausible(measuredDiameter, WHEEL_DIAM) || !plausible(measuredBase, WHEEL_BASE)) {
+    Serial.println("Calibration: result out of range");
+    return false;
+  }
+  applyCalibration(measuredDiameter, measuredBase);
+  
+  // Leave the robot facing north for the start
+  spinAngle(-headingAfter);
+  return true;
+}
+
+bool runCalibration() {
+  Serial.println("Calibration: start cell, facing north");
+  float oldDiameter = wheelDiameter;
+  float oldBase = wheelBase;
+  settle();
+  
+  if (!measureCalibration()) {
+    applyCalibration(oldDiameter, oldBase);
+    return false;
+  }
+  return saveCalibration();
+}
@@ -0,0 +1,77 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "Config.h"
+#include <stdint.h>
+
+/**
+ * @brief Calibration Module
+ *
+ * This module measures and keeps the robot's effective geometry including:
+ * - Effective wheel diameter (tyre size, slip) for encoder distances
+ * - Effective wheel base (scrub in turns) for encoder headings
+ * - Storage of both in ESP32 NVS flash, loaded at startup
+ * - A calibration run in the start cell that measures both against the
+ *   maze walls with the ToF sensors
+ *
+ * Until a calibration is stored, DEFAULT_WHEEL_DIAM_MM and
+ * DEFAULT_WHEEL_BASE_MM are used.
+ */
+
+// Stored calibration format
+const uint16_t CALIBRATION_STORE_MAGIC = 0x434C; // "CL"
+const uint8_t CALIBRATION_STORE_VERSION = 1;
+
+struct StoredCalibration {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t reserved;
+  float wheelDiameter_mm;
+  float wheelBase_mm;
+};
+
+/**
+ * @brief Load the stored calibration from flash
+ * Should be called in setup() before startControlLoop()
+ * @return true if a valid stored calibration was found
+ */
+bool initCalibration();
+
+/**
+ * @brief Run the calibration maneuvers and store the result
+ * The robot must stand in the center of the start cell (0, 0) facing
+ * north, with walls west, south and east of it. It turns around twice in
+ * half turns; the change of its heading on the side walls against the
+ * encoder travel gives the wheel base. Facing the south wall in between
+ * it backs away from it by a known encoder travel, which gives the wheel
+ * diameter. It ends where it started. The stored values are kept if a
+ * measurement fails
+ * @return true if both values were measured and saved
+ */
+bool runCalibration();
+
+/**
+ * @brief Erase the stored calibration and go back to the defaults
+ */
+void clearCalibration();
+
+/**
+ * @brief Get the effective wheel diameter
+ * @return Diameter in mm
+ */
+float getWheelDiameter();
+
+/**
+ * @brief Get the effective wheel base, the track width in pivot turns
+ * @return Wheel base in mm
+ */
+float getWheelBase();
+
+/**
+ * @brief Get the encoder counts per mm of wheel travel
+ * Follows from the effective wheel diameter; read by the control loop
+ * @return Counts per mm
+ */
+float getCountsPerMM();
+
+#endif // CALIBRATION_H
@@ -7,6 +7,23 @@ const int LEFT_MOTOR_PIN2  = 27;
 const int RIGHT_MOTOR_PIN1 = 12; 
 const int RIGHT_MOTOR_PIN2 = 13; 
 
+// ================== Motor Driver (ESP32 LEDC) ==================
+// Frequency x 2^bits must stay within the 80 MHz LEDC clock
+const int MOTOR_PWM_FREQUENCY = 20000;   // Hz, above the audible range
+const int MOTOR_PWM_BITS = 10;           // Duty resolution; at most 11 at 20 kHz, 12 needs <= 19.5 kHz
+const int MOTOR_PWM_FULL = 1 << MOTOR_PWM_BITS; // Duty of an input held high
+const bool MOTOR_BRAKE_ON_STOP = true;   // stopMotors() shorts the motors instead of coasting
+
+// ================== Battery Compensation ==================
+// Motor commands are scaled by BATTERY_NOMINAL_V / measured voltage, so
+// the motor constants below hold from a full to a tired pack
+const int BATTERY_ADC_PIN = 36;           // ADC1 input (VP) behind the divider
+const float BATTERY_DIVIDER_RATIO = 3.0;  // Pack voltage / ADC pin voltage
+const float BATTERY_NOMINAL_V = 7.4;      // Pack voltage the motor constants were tuned at (2S LiPo)
+const float BATTERY_MIN_V = 5.0;          // Lower readings mean no pack on the divider: no compensation
+const int BATTERY_SAMPLE_INTERVAL = 10;   // Motor updates between ADC samples
+const float BATTERY_FILTER = 0.05;        // Weight of each new sample in the low-pass filter
+
 // ================== Encoder Pin Configuration ==================
 const int ENCODER_LEFT_A  = 32;
 const int ENCODER_LEFT_B  = 33;
@@ -16,24 +33,29 @@ const int ENCODER_RIGHT_B = 35;
 // ================== Robot Physical Specifications ==================
 const int ENCODER_PPR   = 7;    
 const int GEAR_RATIO    = 82;  
-const float WHEEL_DIAM  = 40.0; // mm
+const float WHEEL_DIAM  = 40.0; // mm, nominal (see Calibration)
 const float WHEEL_CIRC  = 3.14159 * WHEEL_DIAM;
 const float COUNTS_PER_REV = 4.0 * ENCODER_PPR * GEAR_RATIO; // quadrature ×4
 const float COUNTS_PER_MM  = COUNTS_PER_REV / WHEEL_CIRC;
-const float WHEEL_BASE = 90.0; // mm
+const float WHEEL_BASE = 90.0; // mm, nominal (see Calibration)
 const float TURN_CIRC  = 3.14159 * WHEEL_BASE;
 const long COUNTS_PER_90_DEG = (TURN_CIRC / 4.0) * COUNTS_PER_MM;
 
-// ================== PID Control Parameters ==================
-const float DEFAULT_KP = 1.4;   // Proportional gain
-const float DEFAULT_KI = 0.08;  // Integral gain  
-const float DEFAULT_KD = 1.1;   // Derivative gain
-
 // ================== Maze Configuration ==================
 const int MAZE_ROWS = 16;
 const int MAZE_COLS = 16;
 const int CELL_SIZE_MM = 180;   
 
+// Goal region: lower-left cell and size (center 2x2 block)
+const int GOAL_X = MAZE_COLS / 2 - 1;
+const int GOAL_Y = MAZE_ROWS / 2 - 1;
+const int GOAL_WIDTH = 2;
+const int GOAL_HEIGHT = 2;
+
+// ================== Maze Storage ==================
+const int MAZE_FINGERPRINT_CELLS = 4;  // Cells that must match a stored map before it is trusted
+const int MAZE_SAVE_MAX_CELLS = 12;    // A streaming search stops to save after this many cells with unsaved walls
+
 // ================== TOF Sensor Configuration ==================
 #define I2C_SDA 21
 #define I2C_SCL 22
@@ -45,17 +67,105 @@ const int CELL_SIZE_MM = 180;
 #define ADDR_CENTER 0x32
 
 // ================== Movement Parameters ==================
-const int BASE_SPEED = 140;
-const int MIN_SPEED = 60;
-const int MAX_SPEED = 255;
-const int TURN_SPEED = 80;
+const float BASE_SPEED_MM_S = 500.0;      // Cruise speed of search runs
+const float TURN_SPEED_MM_S = 285.0;      // Wheel speed of search pivots
+const float FAST_RUN_SPEED_MM_S = 700.0;  // Cruise speed of speed runs
+const float FAST_TURN_SPEED_MM_S = 390.0; // Wheel speed of speed run pivots
+const float MAX_WHEEL_SPEED_MM_S = 850.0; // Leaves PWM headroom for the velocity loop
+const int MAX_SPEED = 255;                // Motor command limit (full duty)
+const bool STREAMING_SEARCH = true; // Search without stopping in every cell
+
+// ================== Motion Profile ==================
+const float DRIVE_ACCEL_MM_S2 = 1500.0;   // Acceleration and braking of straight moves
+const float DRIVE_JERK_MM_S3 = 15000.0;   // Jerk limit (S-curve), 0 for trapezoidal profiles
+const float PROFILE_FINAL_SPEED_MM_S = 20.0; // Slowest setpoint before a stop at the target
+const float PROFILE_POSITION_GAIN = 7.0;  // mm/s per mm the robot lags behind the setpoint
+const int DRIVE_TICK_MS = 2;              // Setpoint update interval of moves without ToF readings
+const float MOVE_MAX_LAG_MM = 60.0;       // A move this far behind its profile position is blocked (arcs lag up to 30)
+
+// ================== Smooth Turns ==================
+const float SEARCH_TURN_RADIUS_MM = 60.0; // Arc radius of in-motion turns, above the effective wheel base / 2
+const float SEARCH_DECISION_MM = SEARCH_TURN_RADIUS_MM; // Streaming decisions happen this far before the cell center, where arcs start
+const float SEARCH_TURN_TOLERANCE_MM = 10.0; // An arc may start this much past its start point, the exit straight steers it back
+
+// ================== Calibration ==================
+const float DEFAULT_WHEEL_DIAM_MM = 39.22;    // Effective wheel diameter until calibrated (slip)
+const float DEFAULT_WHEEL_BASE_MM = 98.82;    // Effective wheel base until calibrated (scrub)
+const float CALIBRATION_MAX_ERROR = 0.15;     // Measurements further off WHEEL_DIAM / WHEEL_BASE are rejected
+const int CALIBRATION_SAMPLES = 16;           // ToF readings averaged per measurement
+const float CALIBRATION_DRIVE_MM = 150.0;     // Length of the straight measurement drives
+const float CALIBRATION_COARSE_DRIVE_MM = 40.0; // Short drive that measures a large heading error
+const float CALIBRATION_STRAIGHT_HEADING = 0.15; // rad off the wall that is safe for the long drive
+const int CALIBRATION_STRAIGHTEN_TRIES = 5;   // Corrections after the spin before giving up
+const float CALIBRATION_SPEED_MM_S = 150.0;   // Wheel speed of the calibration maneuvers
+const float CALIBRATION_STRAIGHT_GAIN = 10.0; // mm/s per mm the wheels differ in straight drives
+const int CALIBRATION_SETTLE_MS = 300;        // Standstill before reading the sensors
+const int CALIBRATION_PROMPT_MS = 2000;       // Time after reset to ask for a calibration run
+const char CALIBRATION_COMMAND = 'c';         // Serial command that starts a calibration run
+
+// ================== Control Loop ==================
+const int CONTROL_PERIOD_MS = 1;          // Wheel velocity loop period (1 kHz, one FreeRTOS tick)
+const int CONTROL_TASK_CORE = 0;          // Arduino loop() runs on core 1
+const int CONTROL_TASK_PRIORITY = 5;      // Above loop() (1) so ToF reads never delay a tick
+const int CONTROL_TASK_STACK = 4096;      // Control task stack (bytes)
+
+// ================== Wheel Velocity Control ==================
+const float MOTOR_PWM_PER_MM_S = 0.28;    // Feedforward: PWM per mm/s of wheel speed
+const float MOTOR_STATIC_PWM = 15.0;      // Feedforward: PWM that just overcomes friction
+const float MOTOR_PWM_PER_MM_S2 = 0.014;  // Feedforward: PWM per mm/s² (motor lag)
+const float VELOCITY_KP = 0.6;            // PWM per mm/s of wheel speed error
+const float VELOCITY_KI = 10.0;           // PWM per mm of accumulated wheel speed error
+const float VELOCITY_INTEGRAL_LIMIT = 60.0; // Max PWM from the integral term
+const float VELOCITY_FILTER_S = 0.01;     // Time constant of the measured wheel speed filter
 
 // ================== Distance Thresholds ==================
-const int WALL_FOLLOW_DISTANCE = 55;
 const int OPENING_THRESHOLD = 130;
 const int EMERGENCY_DISTANCE = 25;
 const int FRONT_WALL_THRESHOLD = 130;
 
+// ================== Wall Sampling While Moving ==================
+const int SIDE_SENSOR_LOOKAHEAD_MM = 0;  // How far ahead of the robot center the side beams hit the walls
+const int FRONT_SENSOR_OFFSET_MM = 40;   // Front sensor distance ahead of the robot center
+const int WALL_SAMPLE_MARGIN_MM = 10;    // Side readings count this far inside the next cell's wall segment (clear of the posts)
+const int WALL_SAMPLE_TOLERANCE_MM = 10; // Side readings this far beyond the expected wall face see through an opening
+const int MIN_WALL_SAMPLES = 3;          // Readings per wall, combined by majority; fewer fall back to a scan at the center
+const int TOF_CYCLE_MS = 100;            // Expected duration of readTOF() until one was measured
+
+// ================== Long-Range Wall Inference ==================
+const int SIDE_SENSOR_OFFSET_MM = 30;          // Side sensor distance from the robot center
+const int WALL_INFERENCE_MAX_RANGE_MM = 1000;  // Readings beyond this are too noisy to place a wall
+const int WALL_INFERENCE_TOLERANCE_MM = 45;    // Max error between a reading and a wall edge
+
+// ================== Pose Estimation ==================
+const float WALL_THICKNESS_MM = 12.0;         // Wall faces sit half of it inside the cell edges
+const float POSE_MAX_HEADING_ERROR = 0.2;     // rad off a maze axis beyond which walls are not used
+const float POSE_WALL_TOLERANCE_MM = 30.0;    // Max error between a reading and the expected wall face
+const float POSE_POST_CLEARANCE_MM = 20.0;    // Side readings this close to a cell edge do not correct the pose
+const float POSE_FRONT_RANGE_MM = 250.0;      // Longer front readings do not correct the pose
+const float POSE_SIDE_GAIN = 0.3;             // Share of the lateral error a side reading corrects
+const float POSE_FRONT_GAIN = 0.5;            // Share of the distance error a front reading corrects
+const float POSE_HEADING_LENGTH_MM = 2000.0;  // Heading correction (rad) = side wall residual / this
+const float POSE_DIAGONAL_RANGE_MM = 250.0;   // Longer side readings on a diagonal do not correct the pose
+const float POSE_DIAGONAL_TOLERANCE_MM = 10.0; // Max error between a diagonal side reading and a wall face
+const float POSE_DIAGONAL_GAIN = 0.6;         // Share of the error a diagonal side reading corrects (fewer readings match)
+
+// ================== Front Wall Alignment ==================
+const int FRONT_ALIGN_SAMPLES = 3;             // Center ToF readings averaged before aligning
+const float FRONT_ALIGN_DISTANCE_MM = CELL_SIZE_MM / 2.0 - WALL_THICKNESS_MM / 2 - FRONT_SENSOR_OFFSET_MM; // Center reading at the cell center
+const float FRONT_ALIGN_MIN_READING_MM = 30.0; // Shorter readings may be clamped at the sensor minimum
+const float FRONT_ALIGN_SPEED_MM_S = 150.0;    // Top speed of the alignment move
+const float FRONT_ALIGN_GAIN = 8.0;            // mm/s per mm left to the cell center
+const float FRONT_ALIGN_TOLERANCE_MM = 1.0;    // Close enough to the cell center
+const int FRONT_ALIGN_TIMEOUT_MS = 1000;       // Give up if the wheels cannot move
+
+// ================== Run Trace ==================
+#ifndef TRACE_RECORDING
+#define TRACE_RECORDING 1             // 0 builds the sketch without the trace buffer and recording
+#endif
+const int TRACE_BUFFER_SIZE = 65536;  // Bytes of RAM for the run trace (keeps the newest records when full)
+const unsigned long TRACE_CHECKPOINT_INTERVAL_MS = 2000;  // State checkpoints a trace that lost its start replays from
+const char TRACE_DUMP_COMMAND = 'd';  // Serial command that prints the trace
+
 // ================== LED Pin ==================
 #define LED_BUILTIN 2
 
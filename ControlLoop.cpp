@@ -0,0 +1,47 @@
+#include "ControlLoop.h"
+#include "VelocityControl.h"
+#include <Arduino.h>
+
+bool controlLoopRunning = false;
+
+// Fixed loop period, so the controller gains do not depend on timing
+const float CONTROL_PERIOD_S = CONTROL_PERIOD_MS / 1000.0;
+
+void controlTick() {
+  updateVelocityControl(CONTROL_PERIOD_S);
+}
+
+bool isControlLoopRunning() {
+  return controlLoopRunning;
+}
+
+#ifdef ESP32
+
+static void controlTask(void* parameter) {
+  // Wake on a fixed schedule; a late tick does not shift the next ones
+  TickType_t lastWake = xTaskGetTickCount();
+  while (true) {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CONTROL_PERIOD_MS));
+    controlTick();
+  }
+}
+
+void startControlLoop() {
+  if (controlLoopRunning) return;
+  controlLoopRunning = true;
+  
+  xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, NULL,
+                          CONTROL_TASK_PRIORITY, NULL, CONTROL_TASK_CORE);
+  Serial.print("Control loop started at ");
+  Serial.print(1000 / CONTROL_PERIOD_MS);
+  Serial.println(" Hz");
+}
+
+#else
+
+// The host simulator runs controlTick() on its own clock
+void startControlLoop() {
+  controlLoopRunning = true;
+}
+
+#endif
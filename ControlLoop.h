@@ -0,0 +1,39 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include "Config.h"
+
+/**
+ * @brief Control Loop Module
+ * 
+ * This module runs the wheel velocity loop at a fixed rate, independent
+ * of the blocking ToF reads and the navigation code:
+ * - On the ESP32 a FreeRTOS task on CONTROL_TASK_CORE wakes every
+ *   CONTROL_PERIOD_MS and runs one control tick
+ * - On the host the simulator runs controlTick() from its clock
+ * 
+ * Movement hands down wheel speed setpoints with setWheelVelocities();
+ * the loop measures the wheel speeds, sets the motors and publishes the
+ * measured speeds back (getLeftWheelVelocity(), getRightWheelVelocity()).
+ */
+
+/**
+ * @brief Start the fixed-rate control loop
+ * Call once in setup() after initMotors() and initEncoders(); wheel
+ * speed setpoints take effect from the first tick on
+ */
+void startControlLoop();
+
+/**
+ * @brief Check whether the control loop has been started
+ * @return true once startControlLoop() was called
+ */
+bool isControlLoopRunning();
+
+/**
+ * @brief Run one control period
+ * Called by the control task, or by the host simulator
+ */
+void controlTick();
+
+#endif // CONTROL_LOOP_H
@@ -1,4 +1,5 @@
 #include "Encoder.h"
+#include "TraceRecorder.h"
 #include <Arduino.h>
 
 // Ensure IRAM_ATTR is defined for non-ESP32 platforms
@@ -10,6 +11,11 @@
 volatile long encoderCountLeft  = 0;
 volatile long encoderCountRight = 0;
 
+// Counts at the last resetEncoders(); the ISR counts are never reset, so
+// the control loop measuring wheel speeds sees no jumps
+long encoderOffsetLeft = 0;
+long encoderOffsetRight = 0;
+
 void initEncoders() {
   pinMode(ENCODER_LEFT_A, INPUT_PULLUP);
   pinMode(ENCODER_LEFT_B, INPUT_PULLUP);
@@ -45,18 +51,40 @@ void IRAM_ATTR encoderISRRight() {
 }
 
 void resetEncoders() {
-  encoderCountLeft = 0;
-  encoderCountRight = 0;
+  encoderOffsetLeft = encoderCountLeft;
+  encoderOffsetRight = encoderCountRight;
+}
+
+// Every read goes through the trace so a replay sees the same counts
+static void readEncoders(long& left, long& right) {
+  left = encoderCountLeft - encoderOffsetLeft;
+  right = encoderCountRight - encoderOffsetRight;
+  traceEncoders(left, right);
+}
+
+void getRawEncoderCounts(long& left, long& right) {
+  left = encoderCountLeft;
+  right = encoderCountRight;
 }
 
 long getLeftEncoderCount() {
-  return encoderCountLeft;
+  long left, right;
+  readEncoders(left, right);
+  return left;
 }
 
 long getRightEncoderCount() {
-  return encoderCountRight;
+  long left, right;
+  readEncoders(left, right);
+  return right;
+}
+
+void getEncoderCounts(long& left, long& right) {
+  readEncoders(left, right);
 }
 
 long getAverageEncoderCount() {
-  return (abs(encoderCountLeft) + abs(encoderCountRight)) / 2;
+  long left, right;
+  readEncoders(left, right);
+  return (abs(left) + abs(right)) / 2;
 }
\ No newline at end of file
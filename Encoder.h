@@ -19,7 +19,7 @@
  * - Count retrieval and reset functions
  */
 
-// Global encoder count variables
+// Global encoder count variables (counts since power-up)
 extern volatile long encoderCountLeft;
 extern volatile long encoderCountRight;
 
@@ -43,6 +43,9 @@ void IRAM_ATTR encoderISRRight();
 
 /**
  * @brief Reset both encoder counts to zero
+ * Only the counts returned by the get functions below restart; the raw
+ * counts keep running. Moves do not reset: the odometry integrates these
+ * counts and needs setPose() after a reset
  */
 void resetEncoders();
 
@@ -58,6 +61,21 @@ long getLeftEncoderCount();
  */
 long getRightEncoderCount();
 
+/**
+ * @brief Get both encoder counts from the same moment
+ * @param left Receives the left encoder count
+ * @param right Receives the right encoder count
+ */
+void getEncoderCounts(long& left, long& right);
+
+/**
+ * @brief Get both counts since power-up, for the control loop
+ * Not affected by resetEncoders() and not recorded in the trace
+ * @param left Receives the left encoder count
+ * @param right Receives the right encoder count
+ */
+void getRawEncoderCounts(long& left, long& right);
+
 /**
  * @brief Get the average of both encoder counts
  * @return Average encoder count
@@ -0,0 +1,6 @@
+#include "FloodFill.h"
+
+// Single instantiation of the wavefront for the maze size in Config.h
+template int floodFillWavefront<MAZE_ROWS, MAZE_COLS>(
+    const WallMap& map, const MazeRow goalRows[MAZE_ROWS],
+    FloodDistance flood[MAZE_ROWS][MAZE_COLS], bool unknownIsWall);
@@ -0,0 +1,168 @@
+#ifndef FLOOD_FILL_H
+#define FLOOD_FILL_H
+
+#include "Config.h"
+#include "MazeCore.h"
+#include <stdint.h>
+
+/**
+ * @brief Flood Fill Module
+ * 
+ * Hardware-independent flood fill over the shared-edge wall map:
+ * - Bit-parallel wavefront expansion on row bitboards
+ * - Bit matrix transpose helper for the vertical edge columns
+ * 
+ * Both are templated on the maze dimensions (see MazeCore.h). The
+ * firmware size is instantiated once in FloodFill.cpp; other sizes are
+ * instantiated where they are used.
+ * 
+ * This module does not depend on Arduino.h so it can also be built on a
+ * host machine (see host/bench_flood.cpp).
+ */
+
+/**
+ * @brief Transpose a square bit matrix in place
+ * After the call, bit x of m[y] holds what was bit y of m[x]
+ * @param m One row per bit of Bits (16 rows of uint16_t, 32 of uint32_t)
+ */
+template <typename Bits>
+void transposeBits(Bits m[]);
+
+/**
+ * @brief Compute flood distances with a bit-parallel wavefront
+ * All cells at the same distance are found together by shifting the
+ * frontier rows and masking them with the open-edge bitboards
+ * @param map Wall map to flood (walls set in the map block movement)
+ * @param goalRows Seed bitboard: bit x of goalRows[y] marks goal cell (x, y)
+ * @param flood Output distances, UNREACHABLE for cut-off cells
+ * @param unknownIsWall If true, walls never observed also block movement
+ *                      (pessimistic flood); otherwise they are open
+ * @return Largest distance assigned
+ */
+template <int ROWS, int COLS>
+int floodFillWavefront(const MazeWalls<ROWS, COLS>& map,
+                       const typename MazeGeometry<ROWS, COLS>::Row goalRows[ROWS],
+                       typename MazeGeometry<ROWS, COLS>::Distance flood[ROWS][COLS],
+                       bool unknownIsWall = false);
+
+// ================== Template implementation ==================
+
+template <typename Bits>
+void transposeBits(Bits m[]) {
+  const int N = sizeof(Bits) * 8;
+  
+  // Swap half-size blocks, then quarters, ... and finally single bits
+  Bits mask = (Bits)((Bits)~(Bits)0 >> (N / 2));
+  for(int j = N / 2; j != 0; j >>= 1, mask ^= (Bits)(mask << j)) {
+    for(int k = 0; k < N; k = ((k | j) + 1) & ~j) {
+      Bits t = (Bits)(((m[k] >> j) ^ m[k | j]) & mask);
+      m[k] ^= (Bits)(t << j);
+      m[k | j] ^= t;
+    }
+  }
+}
+
+template <int ROWS, int COLS>
+int floodFillWavefront(const MazeWalls<ROWS, COLS>& map,
+                       const typename MazeGeometry<ROWS, COLS>::Row goalRows[ROWS],
+                       typename MazeGeometry<ROWS, COLS>::Distance flood[ROWS][COLS],
+                       bool unknownIsWall) {
+  typedef MazeGeometry<ROWS, COLS> Geometry;
+  typedef typename Geometry::Row Row;
+  typedef typename Geometry::Square Square;
+  typedef typename Geometry::Distance Distance;
+  const Row rowMask = Geometry::rowMask();
+  const int SQUARE_BITS = sizeof(Square) * 8;
+  
+  // eastOpen[y] bit x: cell (x, y) connects to (x+1, y)
+  // Built from the vertical edge columns with one bit transpose
+  Square columns[SQUARE_BITS];
+  for(int x = 0; x < SQUARE_BITS; x++) {
+    Square open = 0;
+    if(x < COLS - 1) {
+      open = (Square)(~map.vWalls[x + 1] & Geometry::columnMask());
+      if(unknownIsWall) open &= map.vKnown[x + 1];
+    }
+    columns[x] = open;
+  }
+  transposeBits(columns);
+  
+  // Rows are padded by one empty row on each side, so the vertical
+  // neighbors of the first and last row need no bounds checks
+  Row eastOpen[ROWS];
+  Row northOpen[ROWS + 2]; // northOpen[y + 1]: cell (x, y) connects to (x, y+1)
+  northOpen[0] = 0;
+  northOpen[ROWS] = 0;
+  northOpen[ROWS + 1] = 0;
+  for(int y = 0; y < ROWS; y++) {
+    eastOpen[y] = (Row)columns[y] & rowMask;
+    if(y < ROWS - 1) {
+      Row open = (Row)~map.hWalls[y + 1] & rowMask;
+      if(unknownIsWall) open &= map.hKnown[y + 1];
+      northOpen[y + 1] = open;
+    }
+  }
+  
+  for(int r = 0; r < ROWS; r++) {
+    for(int c = 0; c < COLS; c++) {
+      flood[r][c] = Geometry::UNREACHABLE;
+    }
+  }
+  
+  // Distance 0 layer is the goal itself
+  Row reached[ROWS];
+  Row frontier[ROWS + 2];
+  Row next[ROWS];
+  frontier[0] = 0;
+  frontier[ROWS + 1] = 0;
+  bool growing = false;
+  for(int y = 0; y < ROWS; y++) {
+    frontier[y + 1] = goalRows[y] & rowMask;
+    reached[y] = frontier[y + 1];
+    growing |= frontier[y + 1] != 0;
+    
+    Row bits = frontier[y + 1];
+    while(bits) {
+      flood[y][__builtin_ctz(bits)] = 0;
+      bits &= bits - 1;
+    }
+  }
+  
+  int distance = 0;
+  while(growing) {
+    distance++;
+    growing = false;
+    
+    // Grow every frontier row one step in all four directions at once
+    for(int y = 0; y < ROWS; y++) {
+      Row f = frontier[y + 1];
+      Row grow = (Row)((f & eastOpen[y]) << 1) | (Row)((f >> 1) & eastOpen[y]);
+      grow |= frontier[y] & northOpen[y];
+      grow |= frontier[y + 2] & northOpen[y + 1];
+      next[y] = grow & ~reached[y] & rowMask;
+    }
+    
+    // Label the new layer
+    for(int y = 0; y < ROWS; y++) {
+      Row bits = next[y];
+      frontier[y + 1] = bits;
+      reached[y] |= bits;
+      growing |= bits != 0;
+      
+      while(bits) {
+        flood[y][__builtin_ctz(bits)] = (Distance)distance;
+        bits &= bits - 1;
+      }
+    }
+  }
+  
+  // The last pass found nothing new
+  return distance - 1;
+}
+
+// The firmware size is compiled once, in FloodFill.cpp
+extern template int floodFillWavefront<MAZE_ROWS, MAZE_COLS>(
+    const WallMap& map, const MazeRow goalRows[MAZE_ROWS],
+    FloodDistance flood[MAZE_ROWS][MAZE_COLS], bool unknownIsWall);
+
+#endif // FLOOD_FILL_H
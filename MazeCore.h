@@ -0,0 +1,123 @@
+#ifndef MAZE_CORE_H
+#define MAZE_CORE_H
+
+#include "Config.h"
+#include <stdint.h>
+
+/**
+ * @brief Maze Core Types
+ * 
+ * Compile-time sized storage shared by the maze modules:
+ * - Bit rows of the narrowest unsigned type that fits a maze side
+ * - Flood distances in uint8_t (up to 256 cells) or uint16_t
+ * - constexpr direction and neighbor tables
+ * - Shared-edge wall map templated on the maze dimensions
+ * 
+ * The firmware uses the MAZE_ROWS x MAZE_COLS instance through the
+ * typedefs at the end; the templates also build 16x16 classic and
+ * 32x32 half-size mazes on a host machine.
+ */
+
+// Direction mappings: 0=North(UP), 1=East(RIGHT), 2=South(DOWN), 3=West(LEFT)
+constexpr int8_t DIR_DX[4] = {0, 1, 0, -1};
+constexpr int8_t DIR_DY[4] = {1, 0, -1, 0};
+
+constexpr int oppositeDir(int direction) { return direction ^ 2; }
+constexpr int rightOf(int direction) { return (direction + 1) & 3; }
+constexpr int leftOf(int direction) { return (direction + 3) & 3; }
+
+// Type selection without <type_traits> (not available on every core)
+template <bool UseFirst, typename First, typename Second>
+struct SelectType { typedef First type; };
+
+template <typename First, typename Second>
+struct SelectType<false, First, Second> { typedef Second type; };
+
+/**
+ * @brief Narrowest unsigned type holding one bit per cell of a maze side
+ */
+template <int BITS>
+struct BitRow {
+  static_assert(BITS >= 1 && BITS <= 32, "Maze sides are limited to 32 cells");
+  typedef typename SelectType<(BITS <= 16), uint16_t, uint32_t>::type type;
+};
+
+/**
+ * @brief Sizes, storage types and cell indexing of a ROWS x COLS maze
+ */
+template <int ROWS, int COLS>
+struct MazeGeometry {
+  static const int CELLS = ROWS * COLS;
+  static const int MAX_SIDE = (ROWS > COLS) ? ROWS : COLS;
+  
+  typedef typename BitRow<COLS>::type Row;     // Bit x = column x
+  typedef typename BitRow<ROWS>::type Column;  // Bit y = row y
+  typedef typename BitRow<MAX_SIDE>::type Square; // Holds either, for transposes
+  
+  // A path visits each cell at most once, so the longest distance is
+  // CELLS - 1. With 256 cells that collides with the 255 sentinel only
+  // for a maze that is one single corridor
+  typedef typename SelectType<(CELLS <= 256), uint8_t, uint16_t>::type Distance;
+  typedef typename SelectType<(CELLS <= 256), uint8_t, uint16_t>::type CellIndex;
+  static const Distance UNREACHABLE = (Distance)~(Distance)0;
+  
+  static constexpr Row rowMask() {
+    return (Row)((1ULL << COLS) - 1);
+  }
+  static constexpr Column columnMask() {
+    return (Column)((1ULL << ROWS) - 1);
+  }
+  
+  static constexpr CellIndex cellIndex(int x, int y) {
+    return (CellIndex)(y * COLS + x);
+  }
+  static constexpr int cellX(int index) { return index % COLS; }
+  static constexpr int cellY(int index) { return index / COLS; }
+  
+  // Index step to the neighbor in each direction
+  static constexpr int neighborOffset(int direction) {
+    return DIR_DY[direction] * COLS + DIR_DX[direction];
+  }
+};
+
+/**
+ * @brief Shared-edge wall map of a ROWS x COLS maze
+ * Each cell has 4 walls: North(0), East(1), South(2), West(3)
+ * Walls are stored once per edge: hWalls[y] bit x is the south edge of
+ * cell (x, y) and vWalls[x] bit y is its west edge. Index ROWS / COLS
+ * holds the north / east boundary. The known masks mark edges that have
+ * actually been observed.
+ */
+template <int ROWS, int COLS>
+struct MazeWalls {
+  typedef MazeGeometry<ROWS, COLS> Geometry;
+  
+  typename Geometry::Row hWalls[ROWS + 1];
+  typename Geometry::Column vWalls[COLS + 1];
+  typename Geometry::Row hKnown[ROWS + 1];
+  typename Geometry::Column vKnown[COLS + 1];
+  
+  // Closed edges of cell (x, y): bit0=N, bit1=E, bit2=S, bit3=W
+  uint8_t wallMask(int x, int y) const {
+    return ((hWalls[y + 1] >> x) & 1) |
+           (((vWalls[x + 1] >> y) & 1) << 1) |
+           (((hWalls[y] >> x) & 1) << 2) |
+           (((vWalls[x] >> y) & 1) << 3);
+  }
+  
+  // Observed edges of cell (x, y), same bit order
+  uint8_t knownMask(int x, int y) const {
+    return ((hKnown[y + 1] >> x) & 1) |
+           (((vKnown[x + 1] >> y) & 1) << 1) |
+           (((hKnown[y] >> x) & 1) << 2) |
+           (((vKnown[x] >> y) & 1) << 3);
+  }
+};
+
+// Firmware instance sized by Config.h
+typedef MazeGeometry<MAZE_ROWS, MAZE_COLS> Maze;
+typedef Maze::Row MazeRow;
+typedef Maze::Distance FloodDistance;
+typedef MazeWalls<MAZE_ROWS, MAZE_COLS> WallMap;
+
+#endif // MAZE_CORE_H
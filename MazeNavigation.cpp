@@ -1,48 +1,144 @@
 #include "MazeNavigation.h"
+#include "FloodFill.h"
+#include "PathPlanner.h"
+#include "MazeStorage.h"
 #include "TOFSensors.h"
 #include "Movement.h"
 #include "MotorControl.h"
+#include "Odometry.h"
+#include "TraceRecorder.h"
 #include <Arduino.h>
 
 // Position and direction variables
 int currentX = 0, currentY = 0;
 int dir = 0; // 0=UP, 1=RIGHT, 2=DOWN, 3=LEFT
 
-// Goal and start positions
-int goalX = 8;
-int goalY = 8;
+// Goal region and start positions
+// Bit x of goalMask[y] marks goal cell (x, y); set in initMazeNavigation()
+MazeRow goalMask[MAZE_ROWS];
 int startX = 0;
 int startY = 0;
 
+// Decide on the move without stopping in every cell
+bool streamingSearch = STREAMING_SEARCH;
+
+// Walls of the cell being entered were sampled during the move
+bool nextCellSampled = false;
+
+// How the walls of every decision cell were learned
+SearchStats searchStats;
+
+// The target stayed unreachable after the walls were checked again
+bool navigationStuck = false;
+
+// Closer to the cell center than this counts as being there
+const float CELL_CENTER_TOLERANCE_MM = 5.0;
+
+// Cell set the flood is currently seeded from
+int navigationTarget = TARGET_GOAL;
+
 // Maze data structures
-int flood[MAZE_ROWS][MAZE_COLS];
+FloodDistance flood[MAZE_ROWS][MAZE_COLS];
 bool visited[MAZE_ROWS][MAZE_COLS];
 
 // Wall mapping data structures
-// Each cell has 4 walls: North(0), East(1), South(2), West(3)
-bool walls[MAZE_ROWS][MAZE_COLS][4];
-bool wallsDiscovered[MAZE_ROWS][MAZE_COLS][4];
+// Shared-edge bit map - every wall segment is stored exactly once
+WallMap wallMap;
+
+// Edges whose value was observed twice in a row, in the layout of the
+// wall map. A closed wall seen once may be a bad reading; the boundary is
+// always confirmed
+MazeRow hConfirmed[MAZE_ROWS + 1];
+Maze::Column vConfirmed[MAZE_COLS + 1];
 
-// Direction mappings for easier calculation
-const int dx[] = {0, 1, 0, -1}; // North, East, South, West
-const int dy[] = {1, 0, -1, 0};
+// Direction names for debug output (offsets are DIR_DX / DIR_DY)
 const char* dirNames[] = {"North", "East", "South", "West"};
 
+// Dirty-wall tracking for incremental flood updates
+// Walls that turned from open to closed since the last flood update
+const int MAX_DIRTY_WALLS = 16;
+int dirtyWallX[MAX_DIRTY_WALLS];
+int dirtyWallY[MAX_DIRTY_WALLS];
+int dirtyWallDir[MAX_DIRTY_WALLS];
+int dirtyWallCount = 0;
+bool floodNeedsFullUpdate = true;
+
+// Counts every change to the wall map (new or different walls)
+unsigned long wallMapRevision = 0;
+
+// Exploration status from the last optimistic/pessimistic flood pair
+int optimisticPathLength = FLOOD_UNREACHABLE;
+int pessimisticPathLength = FLOOD_UNREACHABLE;
+MazeRow explorationCandidates[MAZE_ROWS];
+int explorationCandidateCount = MAZE_ROWS * MAZE_COLS;
+
+// Everything above is saved in trace checkpoints
+static TraceState currentXState("navigation.currentX", &currentX, sizeof(currentX));
+static TraceState currentYState("navigation.currentY", &currentY, sizeof(currentY));
+static TraceState dirState("navigation.dir", &dir, sizeof(dir));
+static TraceState goalMaskState("navigation.goalMask", goalMask, sizeof(goalMask));
+static TraceState startXState("navigation.startX", &startX, sizeof(startX));
+static TraceState startYState("navigation.startY", &startY, sizeof(startY));
+static TraceState streamingSearchState("navigation.streamingSearch", &streamingSearch, sizeof(streamingSearch));
+static TraceState nextCellSampledState("navigation.nextCellSampled", &nextCellSampled, sizeof(nextCellSampled));
+static TraceState searchStatsState("navigation.searchStats", &searchStats, sizeof(searchStats));
+static TraceState navigationStuckState("navigation.stuck", &navigationStuck, sizeof(navigationStuck));
+static TraceState navigationTargetState("navigation.target", &navigationTarget, sizeof(navigationTarget));
+static TraceState floodState("navigation.flood", flood, sizeof(flood));
+static TraceState visitedState("navigation.visited", visited, sizeof(visited));
+static TraceState wallMapState("navigation.wallMap", &wallMap, sizeof(wallMap));
+static TraceState hConfirmedState("navigation.hConfirmed", hConfirmed, sizeof(hConfirmed));
+static TraceState vConfirmedState("navigation.vConfirmed", vConfirmed, sizeof(vConfirmed));
+static TraceState dirtyWallXState("navigation.dirtyWallX", dirtyWallX, sizeof(dirtyWallX));
+static TraceState dirtyWallYState("navigation.dirtyWallY", dirtyWallY, sizeof(dirtyWallY));
+static TraceState dirtyWallDirState("navigation.dirtyWallDir", dirtyWallDir, sizeof(dirtyWallDir));
+static TraceState dirtyWallCountState("navigation.dirtyWallCount", &dirtyWallCount, sizeof(dirtyWallCount));
+static TraceState floodNeedsFullUpdateState("navigation.floodNeedsFullUpdate", &floodNeedsFullUpdate,
+                                            sizeof(floodNeedsFullUpdate));
+static TraceState wallMapRevisionState("navigation.wallMapRevision", &wallMapRevision);
+static TraceState optimisticPathLengthState("navigation.optimisticPathLength", &optimisticPathLength,
+                                            sizeof(optimisticPathLength));
+static TraceState pessimisticPathLengthState("navigation.pessimisticPathLength", &pessimisticPathLength,
+                                             sizeof(pessimisticPathLength));
+static TraceState explorationCandidatesState("navigation.explorationCandidates", explorationCandidates,
+                                             sizeof(explorationCandidates));
+static TraceState explorationCandidateCountState("navigation.explorationCandidateCount", &explorationCandidateCount,
+                                                 sizeof(explorationCandidateCount));
+
+// Budget of cell relaxations before the incremental update gives up
+const int MAX_INCREMENTAL_STEPS = 4 * MAZE_ROWS * MAZE_COLS;
+
+// How far the robot is short of its cell center along its heading, from
+// the pose: streaming moves end at the decision point, SEARCH_DECISION_MM
+// early, and whatever the moves missed by is made up by the next one
+static float cellCenterOffset() {
+  Pose pose = getPose();
+  float centerX = (currentX + 0.5) * CELL_SIZE_MM;
+  float centerY = (currentY + 0.5) * CELL_SIZE_MM;
+  return (centerX - pose.x) * DIR_DX[dir] + (centerY - pose.y) * DIR_DY[dir];
+}
+
+// Place the pose in the center of the start cell, facing north
+static void resetPoseToStart() {
+  setPose((startX + 0.5) * CELL_SIZE_MM, (startY + 0.5) * CELL_SIZE_MM, PI / 2);
+}
+
 void initMazeNavigation() {
+  // Default goal region from Config.h (center block)
+  if(getGoalCellCount() == 0) {
+    setGoalRegion(GOAL_X, GOAL_Y, GOAL_WIDTH, GOAL_HEIGHT);
+  }
+  
   // Initialize position
   currentX = startX;
   currentY = startY;
   dir = 0; // Start facing UP
+  resetPoseToStart();
   
   // Initialize wall mapping - assume no walls initially
-  for(int r = 0; r < MAZE_ROWS; r++) {
-    for(int c = 0; c < MAZE_COLS; c++) {
-      for(int d = 0; d < 4; d++) {
-        walls[r][c][d] = false;
-        wallsDiscovered[r][c][d] = false;
-      }
-    }
-  }
+  memset(&wallMap, 0, sizeof(wallMap));
+  memset(hConfirmed, 0, sizeof(hConfirmed));
+  memset(vConfirmed, 0, sizeof(vConfirmed));
   
   // Add boundary walls
   for(int r = 0; r < MAZE_ROWS; r++) {
@@ -54,127 +150,214 @@ void initMazeNavigation() {
     }
   }
   
+  // Receive the next cell's walls while moving into it
+  nextCellSampled = false;
+  navigationStuck = false;
+  memset(&searchStats, 0, sizeof(searchStats));
+  setWallSampleCallback(onWallsSampled);
+  
   // Initialize flood fill
   initFlood();
   
   // Reset visited array
   resetVisited();
   
+  // A map saved before a reset is held back until the first cells match
+  loadStoredMaze();
+  
   Serial.println("Maze navigation initialized");
   Serial.print("Start position: (");
   Serial.print(startX);
   Serial.print(", ");
   Serial.print(startY);
   Serial.println(")");
-  Serial.print("Goal position: (");
-  Serial.print(goalX);
-  Serial.print(", ");
-  Serial.print(goalY);
-  Serial.println(")");
+  printGoalRegion();
 }
 
 void initFlood() {
-  // Calculate Manhattan distance to goal for each cell
+  // Calculate Manhattan distance to the nearest goal cell for each cell
   for(int r = 0; r < MAZE_ROWS; r++) {
     for(int c = 0; c < MAZE_COLS; c++) {
-      flood[r][c] = abs(r - goalY) + abs(c - goalX);
+      flood[r][c] = FLOOD_UNREACHABLE;
+      for(int gy = 0; gy < MAZE_ROWS; gy++) {
+        MazeRow bits = goalMask[gy];
+        while(bits) {
+          int gx = __builtin_ctz(bits);
+          int distance = abs(r - gy) + abs(c - gx);
+          if(distance < flood[r][c]) flood[r][c] = distance;
+          bits &= bits - 1;
+        }
+      }
     }
   }
+  
+  // Force the first update to run a full recalculation
+  floodNeedsFullUpdate = true;
   Serial.println("Flood fill map initialized");
 }
 
 void updateFlood(int x, int y) {
-  // Recalculate flood fill values based on discovered walls
-  // Use a queue-based flood fill algorithm
-  
-  // Initialize all cells to high value except goal
-  for(int r = 0; r < MAZE_ROWS; r++) {
-    for(int c = 0; c < MAZE_COLS; c++) {
-      flood[r][c] = 999;
-    }
+  // Nothing changed since the last update - flood values are still valid
+  if(!floodNeedsFullUpdate && dirtyWallCount == 0) {
+    return;
   }
   
-  // Set goal to 0
-  flood[goalY][goalX] = 0;
+  // Only re-flood the cells invalidated by new walls when possible
+  if(!floodNeedsFullUpdate && updateFloodIncremental()) {
+    return;
+  }
   
-  // Simple queue implementation using arrays
-  int queueX[MAZE_ROWS * MAZE_COLS];
-  int queueY[MAZE_ROWS * MAZE_COLS];
-  int front = 0, rear = 0;
+  recomputeFlood();
+}
+
+bool updateFloodIncremental() {
+  // Modified flood fill: a new wall can only increase distances, so only
+  // cells next to new walls (and whatever depends on them) need checking.
+  // Each popped cell must equal 1 + the minimum of its open neighbors.
+  // Cells are kept as indices; every neighbor is reached through an open
+  // edge and the boundary is always closed, so no bounds checks are needed
+  static Maze::CellIndex stack[Maze::CELLS];
+  MazeRow inStack[MAZE_ROWS] = {0};
+  int top = 0;
   
-  // Add goal to queue
-  queueX[rear] = goalX;
-  queueY[rear] = goalY;
-  rear++;
+  // Seed with both cells on either side of every new wall
+  for(int i = 0; i < dirtyWallCount; i++) {
+    for(int side = 0; side < 2; side++) {
+      int cellX = dirtyWallX[i] + (side ? DIR_DX[dirtyWallDir[i]] : 0);
+      int cellY = dirtyWallY[i] + (side ? DIR_DY[dirtyWallDir[i]] : 0);
+      
+      if(cellX >= 0 && cellX < MAZE_COLS && cellY >= 0 && cellY < MAZE_ROWS &&
+         !((inStack[cellY] >> cellX) & 1)) {
+        inStack[cellY] |= (MazeRow)1 << cellX;
+        stack[top++] = Maze::cellIndex(cellX, cellY);
+      }
+    }
+  }
   
-  // Process queue
-  while(front < rear) {
-    int currX = queueX[front];
-    int currY = queueY[front];
-    front++;
+  FloodDistance* cells = &flood[0][0];
+  int steps = 0;
+  while(top > 0) {
+    // Cells cut off from the goal count up slowly - let the full BFS handle it
+    if(++steps > MAX_INCREMENTAL_STEPS) {
+      Serial.println("Incremental flood budget exceeded");
+      return false;
+    }
     
-    int currentDistance = flood[currY][currX];
+    int cell = stack[--top];
+    int currX = Maze::cellX(cell);
+    int currY = Maze::cellY(cell);
+    inStack[currY] &= ~((MazeRow)1 << currX);
     
-    // Check all 4 directions
-    for(int d = 0; d < 4; d++) {
-      int newX = currX + dx[d];
-      int newY = currY + dy[d];
-      
-      // Check bounds
-      if(newX >= 0 && newX < MAZE_COLS && newY >= 0 && newY < MAZE_ROWS) {
-        // Check if there's no wall between current and new cell
-        if(!hasWall(currX, currY, d)) {
-          int newDistance = currentDistance + 1;
-          
-          // If we found a shorter path
-          if(newDistance < flood[newY][newX]) {
-            flood[newY][newX] = newDistance;
-            
-            // Add to queue for further processing
-            queueX[rear] = newX;
-            queueY[rear] = newY;
-            rear++;
-          }
-        }
+    if(isTargetCell(currX, currY)) {
+      continue;
+    }
+    
+    // Find lowest reachable neighbor
+    uint8_t open = ~wallMap.wallMask(currX, currY) & 0x0F;
+    int minNeighbor = FLOOD_UNREACHABLE;
+    for(uint8_t bits = open; bits; bits &= bits - 1) {
+      int neighborFlood = cells[cell + Maze::neighborOffset(__builtin_ctz(bits))];
+      if(neighborFlood < minNeighbor) {
+        minNeighbor = neighborFlood;
+      }
+    }
+    
+    int expected = (minNeighbor >= FLOOD_UNREACHABLE) ? FLOOD_UNREACHABLE : minNeighbor + 1;
+    if(cells[cell] == expected) {
+      continue; // Still consistent
+    }
+    
+    // Update and re-check all open neighbors that may depend on this cell
+    cells[cell] = (FloodDistance)expected;
+    for(uint8_t bits = open; bits; bits &= bits - 1) {
+      int d = __builtin_ctz(bits);
+      int newX = currX + DIR_DX[d];
+      int newY = currY + DIR_DY[d];
+      if(!((inStack[newY] >> newX) & 1)) {
+        inStack[newY] |= (MazeRow)1 << newX;
+        stack[top++] = Maze::cellIndex(newX, newY);
       }
     }
   }
   
+  dirtyWallCount = 0;
+  return true;
+}
+
+void recomputeFlood() {
+  // Recalculate flood fill values based on discovered walls
+  // using a bit-parallel wavefront seeded from the navigation target
+  MazeRow targetRows[MAZE_ROWS];
+  getTargetRows(targetRows);
+  
+  floodFillWavefront(wallMap, targetRows, flood);
+  
+  // Flood is now consistent with every known wall
+  dirtyWallCount = 0;
+  floodNeedsFullUpdate = false;
+  
   Serial.println("Flood fill map updated");
 }
 
-void checkGoal() {
-  if (currentX == goalX && currentY == goalY) {
-    stopMotors();
+bool checkGoal() {
+  if (!isTargetCell(currentX, currentY)) {
+    return false;
+  }
+  
+  stopAtCellCenter();
+  saveMazeIfChanged();
+  if (navigationTarget == TARGET_GOAL) {
     digitalWrite(LED_BUILTIN, HIGH);
     Serial.println("🎯 Goal Reached!");
-    Serial.print("Final position: (");
-    Serial.print(currentX);
-    Serial.print(", ");
-    Serial.print(currentY);
-    Serial.println(")");
-    
-    // Goal reached - stop execution
-    while (true) {
-      delay(1000);
-    }
+  } else {
+    digitalWrite(LED_BUILTIN, LOW);
+    Serial.println("🏁 Back at start!");
   }
+  Serial.print("Position: (");
+  Serial.print(currentX);
+  Serial.print(", ");
+  Serial.print(currentY);
+  Serial.println(")");
+  
+  // The map is kept - the caller decides what to do next
+  return true;
 }
 
 void decideAndMove() {
-  // Scan walls in current cell
-  scanWalls();
+  // Walls of this cell were usually sampled on the way in. If that did
+  // not happen (first cell, too few readings) and they are not all known
+  // yet, scan them standing on the cell center: a scan while rolling
+  // would use up the distance left to the decision
+  if(nextCellSampled) {
+    nextCellSampled = false;
+    searchStats.sampledCells++;
+  } else if(getKnownMask(currentX, currentY) != 0x0F) {
+    stopAtCellCenter();
+    scanWalls();
+    searchStats.scannedCells++;
+  }
   
   // Update flood fill based on discovered walls
   updateFlood(currentX, currentY);
   
+  // A wall read wrong can seal the target off. Every neighbor is then as
+  // unreachable as this cell, and the robot would only turn back and forth
+  if(flood[currentY][currentX] >= FLOOD_UNREACHABLE && !reverifyWalls()) {
+    navigationStuck = true;
+    Serial.println("Target unreachable - stopping");
+    return;
+  }
+  
   // Mark current cell as visited
   markCurrentCellVisited();
 
   // Get next direction using flood fill algorithm
   int nextDir = getNextDirection();
+  traceDecision(currentX, currentY, dir, nextDir);
   
   if(nextDir == -1) {
+    stopAtCellCenter();
+    navigationStuck = true;
     Serial.println("No accessible neighbors - stuck!");
     return;
   }
@@ -182,8 +365,42 @@ void decideAndMove() {
   // Calculate required turns
   int turnDiff = (nextDir - dir + 4) % 4;
   
+  // Straight on or a quarter turn on an arc while streaming: no stop, and
+  // no blocking flash write. The arc needs the robot its radius ahead of
+  // the center, where the move to this decision point ended. Once too
+  // many cells went unsaved the robot stops here to save them
+  float centerOffset = cellCenterOffset();
+  bool rolling = streamingSearch;
+  if(rolling && isMazeSaveDue()) {
+    Serial.println("Stopping to save the maze");
+    rolling = false;
+  }
+  bool smoothTurn90 = rolling && (turnDiff == 1 || turnDiff == 3) &&
+                      centerOffset >= SEARCH_TURN_RADIUS_MM - SEARCH_TURN_TOLERANCE_MM;
+  bool keepRolling = rolling && (turnDiff == 0 || smoothTurn90);
+  if(!keepRolling) {
+    stopAtCellCenter();
+  }
+  
+  // Confirm a stored map and save what was learned while standing still
+  onCellScanned(currentX, currentY, !keepRolling);
+  
+  // Streaming moves end at the next cell's decision point
+  float arrivalOffset = streamingSearch ? SEARCH_DECISION_MM : 0;
+  
   // Execute turns
-  if(turnDiff == 1) {
+  if(smoothTurn90) {
+    // Arc around the cell center; it ends on the new heading, the radius
+    // past the center, and the move below goes on from there
+    float entry = centerOffset - SEARCH_TURN_RADIUS_MM;
+    searchStats.arcTurns++;
+    if(!smoothTurn(turnDiff == 1 ? 90 : -90, SEARCH_TURN_RADIUS_MM, entry > 0 ? entry : 0, 0, false)) {
+      recoverFromAbortedMove();
+      return;
+    }
+    Serial.println(turnDiff == 1 ? "Turned right on an arc" : "Turned left on an arc");
+  }
+  else if(turnDiff == 1) {
     // Turn right
     turnRight90();
     Serial.println("Turned right");
@@ -203,8 +420,24 @@ void decideAndMove() {
   // Update current direction
   dir = nextDir;
   
-  // Move forward one cell
-  moveForwardMM(CELL_SIZE_MM);
+  if(turnDiff != 0 && !smoothTurn90) {
+    searchStats.pivotTurns++;
+  }
+  
+  // Move forward into the next cell, sampling its walls - streaming keeps
+  // the motors running so the next decision is made just before its
+  // center. After an arc the robot is already past this cell's center
+  // Slowing down for the side walls only pays off if they are unknown
+  centerOffset = cellCenterOffset();
+  int nextX = currentX + DIR_DX[dir];
+  int nextY = currentY + DIR_DY[dir];
+  bool sidesKnown = isWallKnown(nextX, nextY, (dir + 1) % 4) && isWallKnown(nextX, nextY, (dir + 3) % 4);
+  armWallSampling(CELL_SIZE_MM + centerOffset, !sidesKnown);
+  if(!moveForwardMM(CELL_SIZE_MM + centerOffset - arrivalOffset, !streamingSearch)) {
+    // Stopped short - decide again from the cell the robot is really in
+    recoverFromAbortedMove();
+    return;
+  }
   updatePosition(dir);
   
   Serial.print("Moved to Cell (");
@@ -217,8 +450,78 @@ void decideAndMove() {
   Serial.print(dirNames[dir]);
   Serial.print("), flood value: ");
   Serial.println(flood[currentY][currentX]);
+}
 
-  checkGoal();
+bool reverifyWalls() {
+  stopAtCellCenter();
+  Serial.println("Target unreachable - checking the walls again");
+  
+  // Scan this cell again, then drop every closed wall seen only once; the
+  // search samples them again on the way
+  scanWalls();
+  int forgotten = forgetUnconfirmedWalls();
+  recomputeFlood();
+  
+  Serial.print("Forgot ");
+  Serial.print(forgotten);
+  Serial.println(" unconfirmed walls");
+  return flood[currentY][currentX] < FLOOD_UNREACHABLE;
+}
+
+bool isNavigationStuck() {
+  return navigationStuck;
+}
+
+void setStreamingSearch(bool enabled) {
+  streamingSearch = enabled;
+  if(!enabled) {
+    stopAtCellCenter();
+  }
+}
+
+void stopAtCellCenter() {
+  float centerOffset = cellCenterOffset();
+  if(centerOffset > CELL_CENTER_TOLERANCE_MM) {
+    // Short of the center after a streaming move - finish it and stop
+    moveForwardMM(centerOffset);
+  } else {
+    stopMoving();
+  }
+  
+  // Odometry drifts along straights - snap to the center on a wall ahead
+  if(hasWall(currentX, currentY, dir)) {
+    alignToFrontWall();
+  }
+}
+
+// Take the tracked cell and direction from the pose: the cell it is in
+// and the maze axis nearest to its heading
+static void relocalizeFromPose() {
+  Pose pose = getPose();
+  currentX = constrain((int)floor(pose.x / CELL_SIZE_MM), 0, MAZE_COLS - 1);
+  currentY = constrain((int)floor(pose.y / CELL_SIZE_MM), 0, MAZE_ROWS - 1);
+  
+  // Quarter turns counterclockwise from east: east, north, west, south
+  int quarter = ((int)round(pose.theta / (PI / 2)) % 4 + 4) % 4;
+  dir = (5 - quarter) % 4;
+  
+  Serial.print("Relocalized to Cell (");
+  Serial.print(currentX);
+  Serial.print(", ");
+  Serial.print(currentY);
+  Serial.print(") facing direction ");
+  Serial.println(dir);
+}
+
+void recoverFromAbortedMove() {
+  turnToNearestAxis();
+  relocalizeFromPose();
+  stopAtCellCenter();
+  
+  // Look at the walls again, so one the map is missing is not driven
+  // into a second time
+  scanWalls();
+  searchStats.scannedCells++;
 }
 
 void updatePosition(int direction) {
@@ -233,14 +536,209 @@ void updatePosition(int direction) {
 }
 
 void setGoal(int x, int y) {
-  goalX = constrain(x, 0, MAZE_COLS - 1);
-  goalY = constrain(y, 0, MAZE_ROWS - 1);
+  setGoalRegion(x, y, 1, 1);
+}
+
+void setGoalRegion(int x, int y, int width, int height) {
+  MazeRow rows[MAZE_ROWS] = {0};
   
-  Serial.print("Goal set to: (");
-  Serial.print(goalX);
-  Serial.print(", ");
-  Serial.print(goalY);
-  Serial.println(")");
+  // Clip the rectangle to the maze
+  int x0 = constrain(x, 0, MAZE_COLS - 1);
+  int y0 = constrain(y, 0, MAZE_ROWS - 1);
+  int x1 = constrain(x + width - 1, x0, MAZE_COLS - 1);
+  int y1 = constrain(y + height - 1, y0, MAZE_ROWS - 1);
+  
+  MazeRow rowBits = (MazeRow)(((1ULL << (x1 + 1)) - 1) & ~((1ULL << x0) - 1));
+  for(int r = y0; r <= y1; r++) {
+    rows[r] = rowBits;
+  }
+  
+  setGoalMask(rows);
+}
+
+void setGoalMask(const MazeRow goalRows[MAZE_ROWS]) {
+  for(int r = 0; r < MAZE_ROWS; r++) {
+    goalMask[r] = goalRows[r] & Maze::rowMask();
+  }
+  
+  // Distances to the old goal are meaningless now
+  floodNeedsFullUpdate = true;
+  
+  Serial.print("Goal set to: ");
+  printGoalRegion();
+}
+
+void getGoalRows(MazeRow goalRows[MAZE_ROWS]) {
+  for(int r = 0; r < MAZE_ROWS; r++) {
+    goalRows[r] = goalMask[r];
+  }
+}
+
+bool isGoalCell(int x, int y) {
+  if(x < 0 || x >= MAZE_COLS || y < 0 || y >= MAZE_ROWS) {
+    return false;
+  }
+  return (goalMask[y] >> x) & 1;
+}
+
+int getGoalCellCount() {
+  int count = 0;
+  for(int r = 0; r < MAZE_ROWS; r++) {
+    count += __builtin_popcount(goalMask[r]);
+  }
+  return count;
+}
+
+void printGoalRegion() {
+  Serial.print("Goal cells:");
+  for(int r = 0; r < MAZE_ROWS; r++) {
+    for(int c = 0; c < MAZE_COLS; c++) {
+      if((goalMask[r] >> c) & 1) {
+        Serial.print(" (");
+        Serial.print(c);
+        Serial.print(", ");
+        Serial.print(r);
+        Serial.print(")");
+      }
+    }
+  }
+  Serial.println();
+}
+
+void getTargetRows(MazeRow targetRows[MAZE_ROWS]) {
+  if(navigationTarget == TARGET_GOAL) {
+    getGoalRows(targetRows);
+    return;
+  }
+  
+  for(int r = 0; r < MAZE_ROWS; r++) {
+    targetRows[r] = 0;
+  }
+  targetRows[startY] = (MazeRow)1 << startX;
+}
+
+bool isTargetCell(int x, int y) {
+  if(navigationTarget == TARGET_GOAL) {
+    return isGoalCell(x, y);
+  }
+  return x == startX && y == startY;
+}
+
+bool updateExplorationStatus() {
+  // Shortest start-goal path when unknown walls are open (lower bound)
+  // and when they are closed (a route that is guaranteed to exist)
+  static FloodDistance optimisticGoal[MAZE_ROWS][MAZE_COLS];
+  static FloodDistance pessimisticGoal[MAZE_ROWS][MAZE_COLS];
+  static FloodDistance optimisticStart[MAZE_ROWS][MAZE_COLS];
+  
+  MazeRow goalRows[MAZE_ROWS];
+  MazeRow startRows[MAZE_ROWS] = {0};
+  getGoalRows(goalRows);
+  startRows[startY] = (MazeRow)1 << startX;
+  
+  // Closed walls seen only once are not final: the bounds treat them as
+  // unknown, so a bad reading cannot prove the path
+  static WallMap finalWalls;
+  finalWalls = wallMap;
+  for(int i = 1; i < MAZE_ROWS; i++) {
+    finalWalls.hKnown[i] &= ~(wallMap.hWalls[i] & ~hConfirmed[i]);
+  }
+  for(int i = 1; i < MAZE_COLS; i++) {
+    finalWalls.vKnown[i] &= ~(wallMap.vWalls[i] & ~vConfirmed[i]);
+  }
+  
+  floodFillWavefront(finalWalls, goalRows, optimisticGoal, false);
+  floodFillWavefront(finalWalls, goalRows, pessimisticGoal, true);
+  floodFillWavefront(finalWalls, startRows, optimisticStart, false);
+  
+  optimisticPathLength = optimisticGoal[startY][startX];
+  pessimisticPathLength = pessimisticGoal[startY][startX];
+  
+  // Cells with unknown walls on an optimistic path that beats the
+  // pessimistic one - only visiting these can still improve the run
+  explorationCandidateCount = 0;
+  for(int r = 0; r < MAZE_ROWS; r++) {
+    explorationCandidates[r] = 0;
+    for(int c = 0; c < MAZE_COLS; c++) {
+      if(finalWalls.knownMask(c, r) == 0x0F) continue;
+      if(optimisticStart[r][c] + optimisticGoal[r][c] < pessimisticPathLength) {
+        explorationCandidates[r] |= (MazeRow)1 << c;
+        explorationCandidateCount++;
+      }
+    }
+  }
+  
+  bool complete = pessimisticPathLength != FLOOD_UNREACHABLE &&
+                  optimisticPathLength == pessimisticPathLength;
+  
+  Serial.print("Path bounds: optimistic ");
+  Serial.print(optimisticPathLength);
+  Serial.print(", pessimistic ");
+  Serial.print(pessimisticPathLength);
+  Serial.print(", cells to visit: ");
+  Serial.println(explorationCandidateCount);
+  
+  return complete;
+}
+
+bool isExplorationComplete() {
+  return pessimisticPathLength != FLOOD_UNREACHABLE &&
+         optimisticPathLength == pessimisticPathLength;
+}
+
+int getExplorationCandidates(MazeRow candidateRows[MAZE_ROWS]) {
+  for(int r = 0; r < MAZE_ROWS; r++) {
+    candidateRows[r] = explorationCandidates[r];
+  }
+  return explorationCandidateCount;
+}
+
+void setNavigationTarget(int target) {
+  if(target == navigationTarget) {
+    return;
+  }
+  
+  navigationTarget = target;
+  
+  // Distances to the old target are meaningless now
+  floodNeedsFullUpdate = true;
+  
+  Serial.print("Navigation target: ");
+  Serial.println(target == TARGET_GOAL ? "goal" : "start");
+}
+
+int planSpeedRun(uint8_t* route, int maxSteps, unsigned long* timeMs) {
+  // Only trust walls that were actually seen as open
+  MazeRow goalRows[MAZE_ROWS];
+  getGoalRows(goalRows);
+  
+  int steps = planFastestRoute(wallMap, goalRows, currentX, currentY, dir, true,
+                               route, maxSteps, timeMs);
+  
+  if(steps == PLANNER_NO_ROUTE) {
+    Serial.println("Speed run: no fully explored route to goal");
+  } else {
+    Serial.print("Speed run: ");
+    Serial.print(steps);
+    Serial.print(" cells, estimated ");
+    Serial.print(timeMs ? *timeMs : 0);
+    Serial.println(" ms");
+  }
+  return steps;
+}
+
+int planReturnRoute(uint8_t* route, int maxSteps, unsigned long* timeMs) {
+  // Only trust walls that were actually seen as open
+  MazeRow startRows[MAZE_ROWS] = {0};
+  startRows[startY] = (MazeRow)1 << startX;
+  
+  int steps = planFastestRoute(wallMap, startRows, currentX, currentY, dir, true,
+                               route, maxSteps, timeMs);
+  
+  if(steps == PLANNER_NO_ROUTE) {
+    Serial.println("Return: no fully explored route to start");
+  }
+  return steps;
 }
 
 void setStartPosition(int x, int y) {
@@ -248,6 +746,7 @@ void setStartPosition(int x, int y) {
   startY = constrain(y, 0, MAZE_ROWS - 1);
   currentX = startX;
   currentY = startY;
+  resetPoseToStart();
   
   Serial.print("Start position set to: (");
   Serial.print(startX);
@@ -265,6 +764,10 @@ int getCurrentDirection() {
   return dir;
 }
 
+SearchStats getSearchStats() {
+  return searchStats;
+}
+
 void resetVisited() {
   for(int r = 0; r < MAZE_ROWS; r++) {
     for(int c = 0; c < MAZE_COLS; c++) {
@@ -299,43 +802,59 @@ int getNextDirection() {
   
   // Find neighbor with lowest flood value
   int bestDir = neighbors[0];
-  int bestFlood = 999;
+  int bestFlood = FLOOD_UNREACHABLE;
+  bool bestUnvisited = false;
   
   for(int i = 0; i < numNeighbors; i++) {
     int neighborDir = neighbors[i];
-    int neighborX = currentX + dx[neighborDir];
-    int neighborY = currentY + dy[neighborDir];
+    int neighborX = currentX + DIR_DX[neighborDir];
+    int neighborY = currentY + DIR_DY[neighborDir];
     
     int neighborFlood = flood[neighborY][neighborX];
     
-    if(neighborFlood < bestFlood) {
+    // On ties prefer unvisited cells - they still have walls to discover
+    bool better = neighborFlood < bestFlood ||
+                  (neighborFlood == bestFlood && !bestUnvisited && !visited[neighborY][neighborX]);
+    
+    if(better) {
       bestFlood = neighborFlood;
       bestDir = neighborDir;
+      bestUnvisited = !visited[neighborY][neighborX];
     }
   }
   
+  // No neighbor leads to the target
+  if(bestFlood >= FLOOD_UNREACHABLE) {
+    return -1;
+  }
   return bestDir;
 }
 
 void scanWalls() {
-  readTOF();
-  
   // Convert robot's relative directions to absolute maze directions
   int frontDir = dir;
   int rightDir = (dir + 1) % 4;
   int leftDir = (dir + 3) % 4;
   
-  // Check front wall
-  bool frontWall = isWallFront(130); // 120mm threshold for wall detection
-  setWall(currentX, currentY, frontDir, frontWall);
+  // The majority of MIN_WALL_SAMPLES readings decides each wall. A
+  // decision point short of the center sees the front wall further away
+  int centerOffset = (int)cellCenterOffset();
+  int frontVotes = 0, rightVotes = 0, leftVotes = 0;
+  for(int i = 0; i < MIN_WALL_SAMPLES; i++) {
+    readTOF();
+    frontVotes += isWallFront(130 + centerOffset);
+    rightVotes += isWallRight(130);
+    leftVotes += isWallLeft(130);
+  }
+  
+  bool frontWall = 2 * frontVotes > MIN_WALL_SAMPLES;
+  observeWall(currentX, currentY, frontDir, frontWall);
   
-  // Check right wall  
-  bool rightWall = isWallRight(130); // 80mm threshold for side walls
-  setWall(currentX, currentY, rightDir, rightWall);
+  bool rightWall = 2 * rightVotes > MIN_WALL_SAMPLES;
+  observeWall(currentX, currentY, rightDir, rightWall);
   
-  // Check left wall
-  bool leftWall = isWallLeft(130); // 80mm threshold for side walls
-  setWall(currentX, currentY, leftDir, leftWall);
+  bool leftWall = 2 * leftVotes > MIN_WALL_SAMPLES;
+  observeWall(currentX, currentY, leftDir, leftWall);
   
   Serial.print("Scanned walls at (");
   Serial.print(currentX);
@@ -347,27 +866,251 @@ void scanWalls() {
   Serial.print(rightWall ? "YES" : "NO");
   Serial.print(", Left=");
   Serial.println(leftWall ? "YES" : "NO");
+  
+  // Readings through openings also describe the cells beyond
+  int inferred = 0;
+  if(!frontWall) {
+    inferred += inferWallsAlongBeam(currentX, currentY, frontDir, getCenterDistance(),
+                                    FRONT_SENSOR_OFFSET_MM - centerOffset);
+  }
+  if(!rightWall) {
+    inferred += inferWallsAlongBeam(currentX, currentY, rightDir, getRightDistance(), SIDE_SENSOR_OFFSET_MM);
+  }
+  if(!leftWall) {
+    inferred += inferWallsAlongBeam(currentX, currentY, leftDir, getLeftDistance(), SIDE_SENSOR_OFFSET_MM);
+  }
+  
+  if(inferred > 0) {
+    Serial.print("Inferred ");
+    Serial.print(inferred);
+    Serial.println(" walls along the beams");
+  }
 }
 
-void setWall(int x, int y, int direction, bool hasWallValue) {
-  // Check bounds
+int inferWallsAlongBeam(int x, int y, int direction, int range_mm, int sensorOffset_mm) {
+  // Distance from the cell center to where the beam stopped
+  int hit = range_mm + sensorOffset_mm;
+  
+  // Edge k (k=0 is the current cell's own edge) is this far from the center
+  // Beyond the trusted range nothing is a wall, edges well short of it are open
+  bool hitWall = hit <= WALL_INFERENCE_MAX_RANGE_MM;
+  int reach = hitWall ? hit : WALL_INFERENCE_MAX_RANGE_MM;
+  
+  int learned = 0;
+  int cx = x;
+  int cy = y;
+  for(int k = 1; ; k++) {
+    cx += DIR_DX[direction];
+    cy += DIR_DY[direction];
+    if(cx < 0 || cx >= MAZE_COLS || cy < 0 || cy >= MAZE_ROWS) break;
+    
+    int edge = CELL_SIZE_MM / 2 + k * CELL_SIZE_MM;
+    bool wallHere;
+    if(edge + WALL_INFERENCE_TOLERANCE_MM < reach) {
+      wallHere = false; // The beam went past this edge
+    } else if(hitWall && abs(hit - edge) <= WALL_INFERENCE_TOLERANCE_MM) {
+      wallHere = true;  // The beam ended on this edge
+    } else {
+      break;            // Ambiguous (post, angled beam) or out of range
+    }
+    
+    // Near scans are more reliable - never overwrite what is known
+    if(!isWallKnown(cx, cy, direction)) {
+      setWall(cx, cy, direction, wallHere);
+      learned++;
+    }
+    if(wallHere) break;
+  }
+  
+  return learned;
+}
+
+static const char* wallSampleName(WallSample sample) {
+  if(sample == WALL_UNSAMPLED) return "?";
+  return sample == WALL_SAMPLED_CLOSED ? "YES" : "NO";
+}
+
+void onWallsSampled(WallSample leftWall, WallSample frontWall, WallSample rightWall) {
+  // Still in the previous cell - the walls belong to the one ahead
+  int nextX = currentX + DIR_DX[dir];
+  int nextY = currentY + DIR_DY[dir];
+  if(nextX < 0 || nextX >= MAZE_COLS || nextY < 0 || nextY >= MAZE_ROWS) {
+    return;
+  }
+  
+  WallSample samples[3] = {frontWall, rightWall, leftWall};
+  int directions[3] = {dir, (dir + 1) % 4, (dir + 3) % 4};
+  for(int i = 0; i < 3; i++) {
+    if(samples[i] != WALL_UNSAMPLED) {
+      observeWall(nextX, nextY, directions[i], samples[i] == WALL_SAMPLED_CLOSED);
+    }
+  }
+  
+  // Flood is ready before arrival, so the next decision is immediate.
+  // Walls that are still unknown are scanned from the cell center
+  updateFlood(nextX, nextY);
+  nextCellSampled = getKnownMask(nextX, nextY) == 0x0F;
+  
+  Serial.print("Sampled walls of (");
+  Serial.print(nextX);
+  Serial.print(", ");
+  Serial.print(nextY);
+  Serial.print("): Front=");
+  Serial.print(wallSampleName(frontWall));
+  Serial.print(", Right=");
+  Serial.print(wallSampleName(rightWall));
+  Serial.print(", Left=");
+  Serial.println(wallSampleName(leftWall));
+}
+
+// Rows and columns differ in width for non-square mazes
+template <typename Bits>
+static void writeEdge(Bits& edges, Bits& known, int bit, bool hasWallValue) {
+  if(hasWallValue) {
+    edges |= (Bits)1 << bit;
+  } else {
+    edges &= ~((Bits)1 << bit);
+  }
+  known |= (Bits)1 << bit;
+}
+
+// Find the edge of a cell wall: North/South walls live in the horizontal
+// edge rows, East/West walls in the vertical edge columns; the far edge
+// of a cell is one index further. False outside the maze
+static bool findEdge(int x, int y, int direction, bool* horizontal, int* index, int* bit) {
   if(x < 0 || x >= MAZE_COLS || y < 0 || y >= MAZE_ROWS || direction < 0 || direction >= 4) {
+    return false;
+  }
+  
+  *horizontal = (direction & 1) == 0;
+  *index = *horizontal ? y + (direction == 0) : x + (direction == 1);
+  *bit = *horizontal ? x : y;
+  return true;
+}
+
+static void setEdgeConfirmed(bool horizontal, int index, int bit, bool confirmed) {
+  if(horizontal) {
+    MazeRow mask = (MazeRow)1 << bit;
+    hConfirmed[index] = confirmed ? (hConfirmed[index] | mask) : (hConfirmed[index] & ~mask);
+  } else {
+    Maze::Column mask = (Maze::Column)1 << bit;
+    vConfirmed[index] = confirmed ? (vConfirmed[index] | mask) : (vConfirmed[index] & ~mask);
+  }
+}
+
+void setWall(int x, int y, int direction, bool hasWallValue) {
+  bool horizontal;
+  int index, bit;
+  if(!findEdge(x, y, direction, &horizontal, &index, &bit)) {
+    return;
+  }
+  
+  // The outer boundary can never be opened by a bad reading
+  int lastIndex = horizontal ? MAZE_ROWS : MAZE_COLS;
+  if(index == 0 || index == lastIndex) {
+    hasWallValue = true;
+  }
+  
+  // Track changes that invalidate the flood values; a changed wall has
+  // to be confirmed again
+  bool wasWall = horizontal ? (wallMap.hWalls[index] >> bit) & 1 : (wallMap.vWalls[index] >> bit) & 1;
+  bool wasKnown = horizontal ? (wallMap.hKnown[index] >> bit) & 1 : (wallMap.vKnown[index] >> bit) & 1;
+  if(wasWall != hasWallValue) {
+    markWallDirty(x, y, direction, hasWallValue);
+    setEdgeConfirmed(horizontal, index, bit, false);
+    wallMapRevision++;
+  } else if(!wasKnown) {
+    wallMapRevision++; // Newly observed, same value
+  }
+  
+  // One bit covers both cells that share the edge
+  if(horizontal) {
+    writeEdge(wallMap.hWalls[index], wallMap.hKnown[index], bit, hasWallValue);
+  } else {
+    writeEdge(wallMap.vWalls[index], wallMap.vKnown[index], bit, hasWallValue);
+  }
+}
+
+void observeWall(int x, int y, int direction, bool closed) {
+  bool horizontal;
+  int index, bit;
+  if(!findEdge(x, y, direction, &horizontal, &index, &bit)) {
     return;
   }
   
-  // Set wall for current cell
-  walls[y][x][direction] = hasWallValue;
-  wallsDiscovered[y][x][direction] = true;
+  if(!isWallKnown(x, y, direction)) {
+    setWall(x, y, direction, closed);
+  } else if(hasWall(x, y, direction) == closed) {
+    setEdgeConfirmed(horizontal, index, bit, true);
+  } else if(isWallConfirmed(x, y, direction)) {
+    // One contrary reading only takes the confirmation back
+    setEdgeConfirmed(horizontal, index, bit, false);
+  } else {
+    setWall(x, y, direction, closed);
+  }
+}
+
+bool isWallConfirmed(int x, int y, int direction) {
+  bool horizontal;
+  int index, bit;
+  if(!findEdge(x, y, direction, &horizontal, &index, &bit)) {
+    return true;
+  }
   
-  // Set corresponding wall for adjacent cell
-  int adjX = x + dx[direction];
-  int adjY = y + dy[direction];
-  int oppositeDir = (direction + 2) % 4;
+  int lastIndex = horizontal ? MAZE_ROWS : MAZE_COLS;
+  if(index == 0 || index == lastIndex) {
+    return true;
+  }
+  return horizontal ? (hConfirmed[index] >> bit) & 1 : (vConfirmed[index] >> bit) & 1;
+}
+
+int forgetUnconfirmedWalls() {
+  int forgotten = 0;
+  
+  // Interior edges only - the outer boundary is always confirmed
+  for(int i = 1; i < MAZE_ROWS; i++) {
+    MazeRow suspect = wallMap.hKnown[i] & wallMap.hWalls[i] & ~hConfirmed[i];
+    for(int bit = 0; bit < MAZE_COLS; bit++) {
+      if((suspect >> bit) & 1) forgotten++;
+    }
+    wallMap.hWalls[i] &= ~suspect;
+    wallMap.hKnown[i] &= ~suspect;
+  }
+  for(int i = 1; i < MAZE_COLS; i++) {
+    Maze::Column suspect = wallMap.vKnown[i] & wallMap.vWalls[i] & ~vConfirmed[i];
+    for(int bit = 0; bit < MAZE_ROWS; bit++) {
+      if((suspect >> bit) & 1) forgotten++;
+    }
+    wallMap.vWalls[i] &= ~suspect;
+    wallMap.vKnown[i] &= ~suspect;
+  }
   
-  if(adjX >= 0 && adjX < MAZE_COLS && adjY >= 0 && adjY < MAZE_ROWS) {
-    walls[adjY][adjX][oppositeDir] = hasWallValue;
-    wallsDiscovered[adjY][adjX][oppositeDir] = true;
+  if(forgotten > 0) {
+    invalidateFlood();
+    wallMapRevision++;
   }
+  return forgotten;
+}
+
+void markWallDirty(int x, int y, int direction, bool hasWallValue) {
+  // Removing a wall can shorten paths anywhere - needs a full recalculation
+  if(!hasWallValue || dirtyWallCount >= MAX_DIRTY_WALLS) {
+    floodNeedsFullUpdate = true;
+    return;
+  }
+  
+  dirtyWallX[dirtyWallCount] = x;
+  dirtyWallY[dirtyWallCount] = y;
+  dirtyWallDir[dirtyWallCount] = direction;
+  dirtyWallCount++;
+}
+
+void invalidateFlood() {
+  floodNeedsFullUpdate = true;
+}
+
+int getDirtyWallCount() {
+  return dirtyWallCount;
 }
 
 bool hasWall(int x, int y, int direction) {
@@ -376,23 +1119,35 @@ bool hasWall(int x, int y, int direction) {
     return true; // Assume wall at boundaries
   }
   
-  return walls[y][x][direction];
+  return (getWallMask(x, y) >> direction) & 1;
+}
+
+bool isWallKnown(int x, int y, int direction) {
+  // Check bounds
+  if(x < 0 || x >= MAZE_COLS || y < 0 || y >= MAZE_ROWS || direction < 0 || direction >= 4) {
+    return true; // Boundaries are always known
+  }
+  
+  return (getKnownMask(x, y) >> direction) & 1;
+}
+
+uint8_t getWallMask(int x, int y) {
+  return wallMap.wallMask(x, y);
+}
+
+uint8_t getKnownMask(int x, int y) {
+  return wallMap.knownMask(x, y);
 }
 
 int getAccessibleNeighbors(int x, int y, int* neighbors) {
+  // Boundary edges are always walls, so no separate bounds check is needed
+  uint8_t open = ~getWallMask(x, y) & 0x0F;
   int count = 0;
   
-  for(int d = 0; d < 4; d++) {
-    int newX = x + dx[d];
-    int newY = y + dy[d];
-    
-    // Check bounds
-    if(newX >= 0 && newX < MAZE_COLS && newY >= 0 && newY < MAZE_ROWS) {
-      // Check if there's no wall in this direction
-      if(!hasWall(x, y, d)) {
-        neighbors[count++] = d;
-      }
-    }
+  while(open) {
+    int d = __builtin_ctz(open);
+    neighbors[count++] = d;
+    open &= open - 1;
   }
   
   return count;
@@ -400,17 +1155,13 @@ int getAccessibleNeighbors(int x, int y, int* neighbors) {
 
 void printFloodMap() {
   Serial.println("=== FLOOD FILL MAP ===");
-  Serial.print("Goal: (");
-  Serial.print(goalX);
-  Serial.print(", ");
-  Serial.print(goalY);
-  Serial.println(")");
+  printGoalRegion();
   
   for(int r = MAZE_ROWS - 1; r >= 0; r--) {
     for(int c = 0; c < MAZE_COLS; c++) {
       if(c == currentX && r == currentY) {
         Serial.print(" R ");
-      } else if(c == goalX && r == goalY) {
+      } else if(isGoalCell(c, r)) {
         Serial.print(" G ");
       } else {
         Serial.print(" ");
@@ -439,7 +1190,7 @@ void printWallMap() {
       Serial.print(hasWall(c, r, 3) ? "|" : " ");
       if(c == currentX && r == currentY) {
         Serial.print(" R ");
-      } else if(c == goalX && r == goalY) {
+      } else if(isGoalCell(c, r)) {
         Serial.print(" G ");
       } else {
         Serial.print("   ");
@@ -2,6 +2,9 @@
 #define MAZE_NAVIGATION_H
 
 #include "Config.h"
+#include "MazeCore.h"
+#include "Movement.h"
+#include <stdint.h>
 
 /**
  * @brief Maze Navigation Module
@@ -18,18 +21,37 @@
 extern int currentX, currentY;
 extern int dir; // 0=UP, 1=RIGHT, 2=DOWN, 3=LEFT
 
-// Goal position
-extern int goalX, goalY;
+// Goal region: bit x of goalMask[y] marks goal cell (x, y)
+extern MazeRow goalMask[MAZE_ROWS];
 extern int startX, startY;
 
+// Search without stopping in every cell
+extern bool streamingSearch;
+
+// How the search learned the walls of the cells it decided in
+struct SearchStats {
+  int sampledCells; // Walls sampled while moving into the cell
+  int scannedCells; // Walls scanned at the decision point
+  int arcTurns;     // Quarter turns taken on an arc without stopping
+  int pivotTurns;   // Turns in place after stopping on the cell center
+};
+
+// Navigation targets the flood can be seeded from
+const int TARGET_GOAL = 0;
+const int TARGET_START = 1;
+extern int navigationTarget;
+
+// Flood value for cells that cannot reach the goal
+const int FLOOD_UNREACHABLE = Maze::UNREACHABLE;
+
 // Maze data structures
-extern int flood[MAZE_ROWS][MAZE_COLS];
+extern FloodDistance flood[MAZE_ROWS][MAZE_COLS];
 extern bool visited[MAZE_ROWS][MAZE_COLS];
 
 // Wall mapping data structures
-// Each cell has 4 walls: North(0), East(1), South(2), West(3)
-extern bool walls[MAZE_ROWS][MAZE_COLS][4];
-extern bool wallsDiscovered[MAZE_ROWS][MAZE_COLS][4];
+// Shared-edge bit map, see MazeCore.h for the layout
+extern WallMap wallMap;
+extern unsigned long wallMapRevision;
 
 /**
  * @brief Initialize maze navigation system
@@ -45,27 +67,89 @@ void initFlood();
 
 /**
  * @brief Update flood fill map based on discovered walls
+ * Skips the update when no wall changed, re-floods only the cells
+ * affected by new walls when possible, and falls back to a full BFS
  * @param x Current X position
  * @param y Current Y position
  */
 void updateFlood(int x, int y);
 
 /**
- * @brief Check if robot has reached the goal
- * Handles goal reached behavior
+ * @brief Incrementally repair flood values after new walls were added
+ * Only valid when the flood was consistent before the walls changed
+ * @return true if the flood was repaired, false if a full BFS is needed
+ */
+bool updateFloodIncremental();
+
+/**
+ * @brief Recalculate the whole flood fill map from the goal
+ * Uses the bit-parallel wavefront from the FloodFill module
+ */
+void recomputeFlood();
+
+/**
+ * @brief Check if robot has reached the current navigation target
+ * Triggers on entering any cell of the goal region.
+ * Stops the motors and signals arrival, but keeps the learned maze
+ * @return true if the robot is in a target cell
  */
-void checkGoal();
+bool checkGoal();
 
 /**
  * @brief Make navigation decision and execute movement
- * Uses flood fill algorithm and sensor data to decide next move
+ * Uses flood fill algorithm and sensor data to decide next move.
+ * In streaming mode decisions are made SEARCH_DECISION_MM before the cell
+ * center on walls sampled during the move into the cell. The robot stops
+ * to turn around, and to scan a cell whose walls could not be sampled
  */
 void decideAndMove();
 
+/**
+ * @brief Stop the robot on its cell center
+ * A streaming search stops at decision points short of the center; this
+ * drives the rest of the way before stopping. With a known wall ahead the
+ * distance in the cell is then aligned on it, so pivot turns start from
+ * the measured center
+ */
+void stopAtCellCenter();
+
+/**
+ * @brief Pick up the search after a move that was aborted
+ * Squares the robot up on the nearest maze axis, takes the tracked cell
+ * and direction from the odometry pose instead of the planned move,
+ * stops on that cell's center and scans its walls again
+ */
+void recoverFromAbortedMove();
+
+/**
+ * @brief Check the walls again when the target cannot be reached
+ * Stops on the cell center, scans the cell again and forgets every
+ * closed wall that is not confirmed, then recomputes the flood
+ * @return True if the target can be reached again
+ */
+bool reverifyWalls();
+
+/**
+ * @brief Check if the search gave up on the target
+ * Set by decideAndMove() when the target stayed unreachable after
+ * reverifyWalls(), or the cell has no open side
+ * @return True if the robot stopped for good
+ */
+bool isNavigationStuck();
+
+/**
+ * @brief Enable or disable streaming search
+ * When enabled, straight moves chain without stopping in every cell
+ * @param enabled True to search without stopping
+ */
+void setStreamingSearch(bool enabled);
+
 /**
  * @brief Make navigation decision using flood fill algorithm
- * Chooses the accessible neighbor cell with lowest flood value
- * @return Direction to move (0=UP, 1=RIGHT, 2=DOWN, 3=LEFT, -1=no move)
+ * Chooses the accessible neighbor cell with lowest flood value,
+ * preferring unvisited cells on ties
+ * @return Direction to move (0=UP, 1=RIGHT, 2=DOWN, 3=LEFT), -1 if no
+ *         neighbor can reach the target
  */
 int getNextDirection();
 
@@ -75,6 +159,54 @@ int getNextDirection();
  */
 void scanWalls();
 
+/**
+ * @brief Infer walls of the cells along a ToF beam from the cell center
+ * Every edge the beam passes is open; the edge it ends on is a wall.
+ * Only edges beyond the current cell and not yet known are written
+ * @param x Cell the robot stands in (center)
+ * @param y Cell the robot stands in (center)
+ * @param direction Absolute beam direction (0=UP, 1=RIGHT, 2=DOWN, 3=LEFT)
+ * @param range_mm Sensor reading
+ * @param sensorOffset_mm Sensor distance from the robot center
+ * @return Number of wall facts learned
+ */
+int inferWallsAlongBeam(int x, int y, int direction, int range_mm, int sensorOffset_mm);
+
+/**
+ * @brief Store walls sampled while moving into the next cell
+ * Registered with setWallSampleCallback(); updates the wall map and the
+ * flood before the robot arrives. Unsampled walls that are not known yet
+ * make the navigation scan the cell from its center
+ * @param leftWall Wall on the left of the next cell
+ * @param frontWall Wall ahead of the next cell
+ * @param rightWall Wall on the right of the next cell
+ */
+void onWallsSampled(WallSample leftWall, WallSample frontWall, WallSample rightWall);
+
+/**
+ * @brief Store a sensor observation of a wall
+ * An unknown wall takes the observed value. Observing a known wall again
+ * confirms it if the value agrees. A contrary observation changes an
+ * unconfirmed wall and only takes the confirmation back from a confirmed
+ * one, so a single bad reading never overrides two good ones
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @param direction Wall direction (0=North, 1=East, 2=South, 3=West)
+ * @param closed True if the readings saw a wall
+ */
+void observeWall(int x, int y, int direction, bool closed);
+
+/**
+ * @brief Check if a wall was observed twice with the same value
+ * Closed walls that are not confirmed yet count as unknown in
+ * updateExplorationStatus(), so they cannot end the exploration
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @param direction Wall direction (0=North, 1=East, 2=South, 3=West)
+ * @return True if confirmed, always true for the outer boundary
+ */
+bool isWallConfirmed(int x, int y, int direction);
+
 /**
  * @brief Set wall in the maze map
  * @param x Cell X coordinate
@@ -84,6 +216,34 @@ void scanWalls();
  */
 void setWall(int x, int y, int direction, bool hasWall);
 
+/**
+ * @brief Record a wall change for the next flood update
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @param direction Wall direction (0=North, 1=East, 2=South, 3=West)
+ * @param hasWall New wall state
+ */
+void markWallDirty(int x, int y, int direction, bool hasWall);
+
+/**
+ * @brief Forget the closed walls that were only observed once
+ * They become unknown again and are sampled anew by the search
+ * @return Number of walls forgotten
+ */
+int forgetUnconfirmedWalls();
+
+/**
+ * @brief Force the next flood update to recalculate every cell
+ * Needed after the wall map is changed without setWall()
+ */
+void invalidateFlood();
+
+/**
+ * @brief Get number of wall changes pending for the next flood update
+ * @return Number of dirty walls
+ */
+int getDirtyWallCount();
+
 /**
  * @brief Check if there's a wall in specific direction from cell
  * @param x Cell X coordinate
@@ -93,6 +253,33 @@ void setWall(int x, int y, int direction, bool hasWall);
  */
 bool hasWall(int x, int y, int direction);
 
+/**
+ * @brief Check if the wall in specific direction from cell has been observed
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @param direction Wall direction (0=North, 1=East, 2=South, 3=West)
+ * @return True if the wall state is known
+ */
+bool isWallKnown(int x, int y, int direction);
+
+/**
+ * @brief Get all four walls of a cell as a bit mask
+ * Cell coordinates must be inside the maze
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @return Bit d set if there is a wall in direction d (bit 0=North ... bit 3=West)
+ */
+uint8_t getWallMask(int x, int y);
+
+/**
+ * @brief Get the observed-wall mask of a cell
+ * Cell coordinates must be inside the maze
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @return Bit d set if the wall in direction d is known
+ */
+uint8_t getKnownMask(int x, int y);
+
 /**
  * @brief Get accessible neighbors of a cell
  * @param x Cell X coordinate
@@ -119,12 +306,116 @@ void printWallMap();
 void updatePosition(int direction);
 
 /**
- * @brief Set goal position
+ * @brief Set a single goal cell
  * @param x Goal X coordinate
  * @param y Goal Y coordinate
  */
 void setGoal(int x, int y);
 
+/**
+ * @brief Set a rectangular goal region
+ * Every cell of the region is seeded at flood distance 0
+ * @param x Lower-left X coordinate
+ * @param y Lower-left Y coordinate
+ * @param width Region width in cells
+ * @param height Region height in cells
+ */
+void setGoalRegion(int x, int y, int width, int height);
+
+/**
+ * @brief Set an arbitrary set of goal cells
+ * @param goalRows Bit x of goalRows[y] marks goal cell (x, y)
+ */
+void setGoalMask(const MazeRow goalRows[MAZE_ROWS]);
+
+/**
+ * @brief Check if a cell belongs to the goal region
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @return true if the cell is a goal cell
+ */
+bool isGoalCell(int x, int y);
+
+/**
+ * @brief Get number of cells in the goal region
+ * @return Goal cell count
+ */
+int getGoalCellCount();
+
+/**
+ * @brief Print the goal region cells for debugging
+ */
+void printGoalRegion();
+
+/**
+ * @brief Get the goal as a row bitboard
+ * @param goalRows Output: bit x of goalRows[y] marks goal cell (x, y)
+ */
+void getGoalRows(MazeRow goalRows[MAZE_ROWS]);
+
+/**
+ * @brief Get the current navigation target as a row bitboard
+ * @param targetRows Output: bit x of targetRows[y] marks target cell (x, y)
+ */
+void getTargetRows(MazeRow targetRows[MAZE_ROWS]);
+
+/**
+ * @brief Check if a cell belongs to the current navigation target
+ * @param x Cell X coordinate
+ * @param y Cell Y coordinate
+ * @return true if the flood is seeded from this cell
+ */
+bool isTargetCell(int x, int y);
+
+/**
+ * @brief Compare optimistic and pessimistic start-to-goal distances
+ * Floods once with unknown walls open and once with them closed, and
+ * collects the cells that could still shorten the best proven path
+ * @return true if the shortest path is proven and exploration can stop
+ */
+bool updateExplorationStatus();
+
+/**
+ * @brief Check result of the last updateExplorationStatus() call
+ * @return true if optimistic and pessimistic path lengths match
+ */
+bool isExplorationComplete();
+
+/**
+ * @brief Get cells that still have to be visited to close the gap
+ * Valid after updateExplorationStatus()
+ * @param candidateRows Output: bit x of candidateRows[y] marks cell (x, y)
+ * @return Number of candidate cells
+ */
+int getExplorationCandidates(MazeRow candidateRows[MAZE_ROWS]);
+
+/**
+ * @brief Select which cells the flood leads to
+ * @param target TARGET_GOAL or TARGET_START
+ */
+void setNavigationTarget(int target);
+
+/**
+ * @brief Plan the minimum-time speed run from the current pose to the goal
+ * Searches over (cell, heading) with turn-penalized costs and only
+ * crosses walls that were observed as open
+ * @param route Output: absolute direction of every cell step
+ * @param maxSteps Capacity of the route array
+ * @param timeMs Optional output: estimated run time in milliseconds
+ * @return Number of cell steps, or -1 if no explored route exists
+ */
+int planSpeedRun(uint8_t* route, int maxSteps, unsigned long* timeMs);
+
+/**
+ * @brief Plan the minimum-time route from the current pose back to the start
+ * Only crosses walls that were observed as open
+ * @param route Output: absolute direction of every cell step
+ * @param maxSteps Capacity of the route array
+ * @param timeMs Optional output: estimated run time in milliseconds
+ * @return Number of cell steps, or -1 if no explored route exists
+ */
+int planReturnRoute(uint8_t* route, int maxSteps, unsigned long* timeMs);
+
 /**
  * @brief Set starting position
  * @param x Start X coordinate
@@ -145,6 +436,12 @@ void getCurrentPosition(int* x, int* y);
  */
 int getCurrentDirection();
 
+/**
+ * @brief Get the search statistics since initMazeNavigation()
+ * @return Counts of how the search learned its cells' walls
+ */
+SearchStats getSearchStats();
+
 /**
  * @brief Reset visited cells array
  */
@@ -0,0 +1,187 @@
+#include "MazeStorage.h"
+#include "TraceRecorder.h"
+#include <Arduino.h>
+#include <Preferences.h>
+#include <stddef.h>
+#include <string.h>
+
+// NVS namespace and key
+const char* MAZE_STORE_NAMESPACE = "maze";
+const char* MAZE_STORE_KEY = "map";
+
+Preferences mazePrefs;
+
+// Stored map waiting for confirmation
+StoredMaze pendingMaze;
+bool storedMazePending = false;
+int fingerprintCellsMatched = 0;
+
+// Last wall map revision written to flash, and the scanned cells since
+// then that changed the map
+unsigned long savedRevision = 0;
+int unsavedCells = 0;
+
+// Saved in trace checkpoints
+static TraceState pendingMazeState("storage.pendingMaze", &pendingMaze, sizeof(pendingMaze));
+static TraceState storedMazePendingState("storage.storedMazePending", &storedMazePending, sizeof(storedMazePending));
+static TraceState fingerprintCellsMatchedState("storage.fingerprintCellsMatched", &fingerprintCellsMatched,
+                                               sizeof(fingerprintCellsMatched));
+static TraceState savedRevisionState("storage.savedRevision", &savedRevision);
+static TraceState unsavedCellsState("storage.unsavedCells", &unsavedCells, sizeof(unsavedCells));
+
+static uint16_t mazeChecksum(const StoredMaze& maze) {
+  // Fletcher-16 over everything but the checksum itself
+  const uint8_t* data = (const uint8_t*)&maze;
+  size_t length = offsetof(StoredMaze, checksum);
+  uint16_t sum1 = 0, sum2 = 0;
+  for (size_t i = 0; i < length; i++) {
+    sum1 = (sum1 + data[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+// Does the stored map agree with every wall observed around this cell?
+static bool cellMatchesStored(int x, int y) {
+  const WallMap& stored = pendingMaze.walls;
+  uint8_t compared = stored.knownMask(x, y) & getKnownMask(x, y);
+  return ((stored.wallMask(x, y) ^ getWallMask(x, y)) & compared) == 0;
+}
+
+// Fill in everything the stored map knows that this run has not seen
+static void mergeStoredMaze() {
+  const WallMap& stored = pendingMaze.walls;
+  for (int i = 0; i <= MAZE_ROWS; i++) {
+    MazeRow take = stored.hKnown[i] & ~wallMap.hKnown[i];
+    wallMap.hWalls[i] = (wallMap.hWalls[i] & ~take) | (stored.hWalls[i] & take);
+    wallMap.hKnown[i] |= take;
+  }
+  for (int i = 0; i <= MAZE_COLS; i++) {
+    Maze::Column take = stored.vKnown[i] & ~wallMap.vKnown[i];
+    wallMap.vWalls[i] = (wallMap.vWalls[i] & ~take) | (stored.vWalls[i] & take);
+    wallMap.vKnown[i] |= take;
+  }
+  for (int r = 0; r < MAZE_ROWS; r++) {
+    for (int c = 0; c < MAZE_COLS; c++) {
+      if ((pendingMaze.visitedRows[r] >> c) & 1) visited[r][c] = true;
+    }
+  }
+  
+  wallMapRevision++;
+  invalidateFlood();
+}
+
+bool loadStoredMaze() {
+  storedMazePending = false;
+  fingerprintCellsMatched = 0;
+  savedRevision = wallMapRevision;
+  
+  mazePrefs.begin(MAZE_STORE_NAMESPACE, true);
+  size_t length = mazePrefs.getBytesLength(MAZE_STORE_KEY);
+  bool found = length == sizeof(StoredMaze) &&
+               mazePrefs.getBytes(MAZE_STORE_KEY, &pendingMaze, sizeof(StoredMaze)) == sizeof(StoredMaze);
+  mazePrefs.end();
+  traceBytes(&pendingMaze, sizeof(StoredMaze), found);
+  
+  if (!found) {
+    Serial.println("No stored maze");
+    return false;
+  }
+  
+  if (pendingMaze.magic != MAZE_STORE_MAGIC || pendingMaze.version != MAZE_STORE_VERSION ||
+      pendingMaze.rows != MAZE_ROWS || pendingMaze.cols != MAZE_COLS ||
+      pendingMaze.checksum != mazeChecksum(pendingMaze)) {
+    Serial.println("Stored maze invalid - ignoring it");
+    return false;
+  }
+  
+  if (pendingMaze.startX != startX || pendingMaze.startY != startY) {
+    Serial.println("Stored maze has a different start - ignoring it");
+    return false;
+  }
+  
+  storedMazePending = true;
+  Serial.println("Stored maze found - waiting for fingerprint match");
+  return true;
+}
+
+void onCellScanned(int x, int y, bool standingStill) {
+  if (storedMazePending) {
+    if (!cellMatchesStored(x, y)) {
+      // Different maze: drop the stored map and start saving this one
+      storedMazePending = false;
+      Serial.println("Stored maze fingerprint mismatch - discarding it");
+    }
+    else if (++fingerprintCellsMatched >= MAZE_FINGERPRINT_CELLS) {
+      storedMazePending = false;
+      mergeStoredMaze();
+      Serial.println("Stored maze fingerprint matched - map restored");
+    }
+    else {
+      // Keep the stored map in flash until it is confirmed or rejected
+      return;
+    }
+  }
+  
+  if (wallMapRevision == savedRevision) {
+    return;
+  }
+  if (standingStill) {
+    saveMaze();
+  } else {
+    unsavedCells++;
+  }
+}
+
+bool isMazeSaveDue() {
+  return unsavedCells >= MAZE_SAVE_MAX_CELLS && !storedMazePending;
+}
+
+void saveMazeIfChanged() {
+  if (!storedMazePending && wallMapRevision != savedRevision) {
+    saveMaze();
+  }
+}
+
+bool saveMaze() {
+  StoredMaze maze;
+  memset(&maze, 0, sizeof(maze));
+  maze.magic = MAZE_STORE_MAGIC;
+  maze.version = MAZE_STORE_VERSION;
+  maze.rows = MAZE_ROWS;
+  maze.cols = MAZE_COLS;
+  maze.startX = startX;
+  maze.startY = startY;
+  maze.walls = wallMap;
+  for (int r = 0; r < MAZE_ROWS; r++) {
+    for (int c = 0; c < MAZE_COLS; c++) {
+      if (visited[r][c]) maze.visitedRows[r] |= (MazeRow)1 << c;
+    }
+  }
+  maze.checksum = mazeChecksum(maze);
+  
+  mazePrefs.begin(MAZE_STORE_NAMESPACE, false);
+  bool ok = mazePrefs.putBytes(MAZE_STORE_KEY, &maze, sizeof(maze)) == sizeof(maze);
+  mazePrefs.end();
+  
+  if (ok) {
+    savedRevision = wallMapRevision;
+    unsavedCells = 0;
+  } else {
+    Serial.println("Failed to save maze");
+  }
+  return ok;
+}
+
+void clearStoredMaze() {
+  mazePrefs.begin(MAZE_STORE_NAMESPACE, false);
+  mazePrefs.remove(MAZE_STORE_KEY);
+  mazePrefs.end();
+  
+  storedMazePending = false;
+  Serial.println("Stored maze cleared");
+}
+
+bool isStoredMazePending() {
+  return storedMazePending;
+}
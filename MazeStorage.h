@@ -0,0 +1,89 @@
+#ifndef MAZE_STORAGE_H
+#define MAZE_STORAGE_H
+
+#include "Config.h"
+#include "MazeNavigation.h"
+#include <stdint.h>
+
+/**
+ * @brief Maze Storage Module
+ * 
+ * This module keeps the learned maze across resets including:
+ * - Compact versioned maze image in ESP32 NVS flash
+ * - Incremental saves of a changed wall map whenever the robot stops,
+ *   and a stop for a save after MAZE_SAVE_MAX_CELLS unsaved cells
+ * - Loading a stored map at startup
+ * - Fingerprint check of the first observed cells before a stored
+ *   map is merged into the live one
+ */
+
+// Stored maze format
+const uint16_t MAZE_STORE_MAGIC = 0x4D5A; // "MZ"
+const uint8_t MAZE_STORE_VERSION = 1;
+
+struct StoredMaze {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t rows;
+  uint8_t cols;
+  uint8_t startX;
+  uint8_t startY;
+  uint8_t reserved;
+  WallMap walls;
+  MazeRow visitedRows[MAZE_ROWS];
+  uint16_t checksum;
+};
+
+/**
+ * @brief Load the stored maze from flash
+ * The map is kept pending until MAZE_FINGERPRINT_CELLS scanned cells
+ * agree with it. Called from initMazeNavigation()
+ * @return true if a valid stored maze was found
+ */
+bool loadStoredMaze();
+
+/**
+ * @brief Handle a freshly scanned cell
+ * Checks the fingerprint of a pending stored map and saves the wall map
+ * to flash if it changed. Flash writes block, so saving is deferred
+ * while the robot is moving and the cell is counted towards
+ * isMazeSaveDue()
+ * @param x Scanned cell X coordinate
+ * @param y Scanned cell Y coordinate
+ * @param standingStill True if a flash write may block now
+ */
+void onCellScanned(int x, int y, bool standingStill);
+
+/**
+ * @brief Check if a streaming search should stop in this cell to save
+ * Bounds what a reset can lose: MAZE_SAVE_MAX_CELLS cells with unsaved
+ * walls have been passed without stopping
+ * @return true if the next decision should stop and save
+ */
+bool isMazeSaveDue();
+
+/**
+ * @brief Save the wall map if it changed since the last save
+ * For places where the robot stands still outside a cell scan, e.g. on
+ * reaching the goal. Does nothing while a stored map is pending
+ */
+void saveMazeIfChanged();
+
+/**
+ * @brief Write the current maze state to flash
+ * @return true if the write succeeded
+ */
+bool saveMaze();
+
+/**
+ * @brief Erase the stored maze (e.g. for a new maze)
+ */
+void clearStoredMaze();
+
+/**
+ * @brief Check if a stored map is waiting for fingerprint confirmation
+ * @return true while the stored map is not yet trusted
+ */
+bool isStoredMazePending();
+
+#endif // MAZE_STORAGE_H
@@ -0,0 +1,237 @@
+#include "Mission.h"
+#include "MazeNavigation.h"
+#include "PathCompiler.h"
+#include "Movement.h"
+#include "MotorControl.h"
+#include "TraceRecorder.h"
+#include <Arduino.h>
+
+// Mission state
+MissionPhase missionPhase = PHASE_EXPLORE;
+int speedRunCount = 0;
+
+// Saved in trace checkpoints
+static TraceState missionPhaseState("mission.phase", &missionPhase, sizeof(missionPhase));
+static TraceState speedRunCountState("mission.speedRunCount", &speedRunCount, sizeof(speedRunCount));
+
+// Route and compiled plan buffers for the speed run
+const int MAX_ROUTE_STEPS = MAZE_ROWS * MAZE_COLS;
+const int MAX_PLAN_PRIMITIVES = MAZE_ROWS * MAZE_COLS;
+uint8_t speedRoute[MAX_ROUTE_STEPS];
+MotionPrimitive speedPlan[MAX_PLAN_PRIMITIVES];
+
+// Route being driven, one primitive per runMission() call, so loop()
+// keeps running during long runs
+int routeSteps = 0;  // Cell steps of the route, 0 while none is driven
+int routePrimitives = 0;
+MotionPlanProgress routeProgress;
+
+// Start and estimated duration of the speed run being driven
+unsigned long speedRunStartMs = 0;
+unsigned long speedRunEstimateMs = 0;
+
+static TraceState speedRouteState("mission.speedRoute", speedRoute, sizeof(speedRoute));
+static TraceState speedPlanState("mission.speedPlan", speedPlan, sizeof(speedPlan));
+static TraceState routeStepsState("mission.routeSteps", &routeSteps, sizeof(routeSteps));
+static TraceState routePrimitivesState("mission.routePrimitives", &routePrimitives, sizeof(routePrimitives));
+static TraceState routeProgressState("mission.routeProgress", &routeProgress, sizeof(routeProgress));
+static TraceState speedRunStartState("mission.speedRunStart", &speedRunStartMs);
+static TraceState speedRunEstimateState("mission.speedRunEstimate", &speedRunEstimateMs);
+
+static void enterPhase(MissionPhase phase) {
+  missionPhase = phase;
+  
+  switch (phase) {
+    case PHASE_EXPLORE:
+      setNavigationTarget(TARGET_GOAL);
+      Serial.println("Mission: exploring to goal");
+      break;
+    case PHASE_RETURN:
+      setNavigationTarget(TARGET_START);
+      Serial.println("Mission: returning to start");
+      break;
+    case PHASE_SPEED_RUN:
+      Serial.println("Mission: speed run");
+      break;
+    case PHASE_STOPPED:
+      stopMoving();
+      Serial.println("Mission: stopped, the target cannot be reached");
+      break;
+  }
+}
+
+// Compile a planned route and set off along it; runMission() drives it
+// from here on
+static bool startRoute(int steps, float driveSpeed, float turnSpeed) {
+  int count = compilePath(speedRoute, steps, getCurrentDirection(), true,
+                          speedPlan, MAX_PLAN_PRIMITIVES);
+  if (count < 0) {
+    Serial.println("Mission: route plan too long");
+    return false;
+  }
+  
+  Serial.print("Mission: driving ");
+  Serial.print(count);
+  Serial.println(" primitives");
+  
+  // A streaming search may still be rolling, short of the cell center
+  stopAtCellCenter();
+  
+  setMovementSpeeds(driveSpeed, turnSpeed);
+  startMotionPlan(routeProgress);
+  routeSteps = steps;
+  routePrimitives = count;
+  return true;
+}
+
+// One search step back towards the start
+static void searchBack() {
+  decideAndMove();
+  if (isNavigationStuck()) {
+    enterPhase(PHASE_STOPPED);
+  } else if (checkGoal()) {
+    enterPhase(PHASE_SPEED_RUN);
+  }
+}
+
+// Once the best path is proven, head straight back over known walls
+static bool startReturnRoute() {
+  int steps = planReturnRoute(speedRoute, MAX_ROUTE_STEPS, NULL);
+  return steps > 0 && startRoute(steps, BASE_SPEED_MM_S, TURN_SPEED_MM_S);
+}
+
+static void finishReturnRoute(bool completed) {
+  if (!completed) {
+    searchBack(); // Keep searching back instead
+    return;
+  }
+  
+  checkGoal();
+  enterPhase(PHASE_SPEED_RUN);
+}
+
+static void startSpeedRun() {
+  int steps = planSpeedRun(speedRoute, MAX_ROUTE_STEPS, NULL);
+  
+  // Not enough of the maze is known yet - keep searching
+  if (steps <= 0) {
+    enterPhase(PHASE_EXPLORE);
+    return;
+  }
+  
+  Serial.print("Mission: speed run ");
+  Serial.println(speedRunCount + 1);
+  
+  if (!startRoute(steps, FAST_RUN_SPEED_MM_S, FAST_TURN_SPEED_MM_S)) {
+    enterPhase(PHASE_EXPLORE);
+    return;
+  }
+  
+  // Timed from the start cell center, where the compiled run starts
+  speedRunEstimateMs = motionPlanTimeMs(speedPlan, routePrimitives,
+                                        FAST_RUN_SPEED_MM_S, FAST_TURN_SPEED_MM_S);
+  speedRunStartMs = millis();
+  traceClock(speedRunStartMs);
+}
+
+static void finishSpeedRun(bool completed) {
+  if (!completed) {
+    enterPhase(PHASE_EXPLORE);
+    return;
+  }
+  
+  unsigned long now = millis();
+  traceClock(now);
+  speedRunCount++;
+  
+  Serial.print("Mission: speed run took ");
+  Serial.print(now - speedRunStartMs);
+  Serial.print(" ms (estimated ");
+  Serial.print(speedRunEstimateMs);
+  Serial.print(" ms) at ");
+  Serial.print(getBatteryVoltage(), 2);
+  Serial.println("V");
+  
+  // The route ends in the goal, the target the return phase replaces
+  setNavigationTarget(TARGET_GOAL);
+  checkGoal();
+  enterPhase(PHASE_RETURN);
+}
+
+// Drive the next primitive of the route. At the end of the route the
+// tracked position jumps there; if it is aborted, the position is taken
+// from the pose instead, ready to search on from there
+static void continueRoute() {
+  bool completed = executeMotionStep(speedPlan, routePrimitives, routeProgress);
+  if (completed && routeProgress.next < routePrimitives) return;
+  
+  int steps = routeSteps;
+  routeSteps = 0;
+  setMovementSpeeds(BASE_SPEED_MM_S, TURN_SPEED_MM_S);
+  
+  if (completed) {
+    for (int i = 0; i < steps; i++) {
+      updatePosition(speedRoute[i]);
+    }
+    dir = speedRoute[steps - 1];
+  } else {
+    Serial.println("Mission: route aborted");
+    recoverFromAbortedMove();
+  }
+  
+  if (missionPhase == PHASE_SPEED_RUN) {
+    finishSpeedRun(completed);
+  } else {
+    finishReturnRoute(completed);
+  }
+}
+
+void initMission() {
+  speedRunCount = 0;
+  routeSteps = 0;
+  setMovementSpeeds(BASE_SPEED_MM_S, TURN_SPEED_MM_S);
+  enterPhase(PHASE_EXPLORE);
+}
+
+void runMission() {
+  if (routeSteps > 0) {
+    continueRoute();
+    return;
+  }
+  
+  switch (missionPhase) {
+    case PHASE_EXPLORE:
+      decideAndMove();
+      if (isNavigationStuck()) {
+        enterPhase(PHASE_STOPPED);
+      } else if (checkGoal()) {
+        enterPhase(PHASE_RETURN);
+      }
+      break;
+      
+    case PHASE_RETURN:
+      // Stop searching as soon as no unexplored cell can improve the run
+      if (updateExplorationStatus() && startReturnRoute()) break;
+      searchBack();
+      break;
+      
+    case PHASE_SPEED_RUN:
+      startSpeedRun();
+      break;
+      
+    case PHASE_STOPPED:
+      break;
+  }
+}
+
+bool isDrivingRoute() {
+  return routeSteps > 0;
+}
+
+MissionPhase getMissionPhase() {
+  return missionPhase;
+}
+
+int getSpeedRunCount() {
+  return speedRunCount;
+}
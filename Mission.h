@@ -0,0 +1,58 @@
+#ifndef MISSION_H
+#define MISSION_H
+
+#include "Config.h"
+
+/**
+ * @brief Mission Module
+ * 
+ * This module sequences the whole competition run including:
+ * - Exploring from the start to the goal
+ * - Returning to the start while gathering more walls
+ * - Speed runs along the fastest known path
+ * - Repeating return and speed run cycles with the learned maze
+ */
+
+// Mission phases
+enum MissionPhase {
+  PHASE_EXPLORE,   // Search toward the goal
+  PHASE_RETURN,    // Search back toward the start
+  PHASE_SPEED_RUN, // Fast run along the planned route
+  PHASE_STOPPED    // Target unreachable - standing still until a reset
+};
+
+/**
+ * @brief Initialize the mission controller
+ * Should be called in setup() after initMazeNavigation()
+ */
+void initMission();
+
+/**
+ * @brief Run one step of the mission
+ * Moves one cell while searching, or one motion primitive of a planned
+ * route (the way back over known walls, or a speed run)
+ * Should be called repeatedly from loop()
+ */
+void runMission();
+
+/**
+ * @brief Check if a planned route is being driven
+ * The robot may be rolling between its primitives, so loop() must call
+ * runMission() again without a pause
+ * @return True between the first and the last primitive of a route
+ */
+bool isDrivingRoute();
+
+/**
+ * @brief Get the current mission phase
+ * @return Current phase
+ */
+MissionPhase getMissionPhase();
+
+/**
+ * @brief Get number of completed speed runs
+ * @return Speed run count
+ */
+int getSpeedRunCount();
+
+#endif // MISSION_H
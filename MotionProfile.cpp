@@ -0,0 +1,112 @@
+#include "MotionProfile.h"
+#include "Config.h"
+#include <math.h>
+
+float brakingDistance(float fromVelocity, float toVelocity, float acceleration, float jerk) {
+  if (fromVelocity <= toVelocity) return 0;
+  
+  // Constant braking plus the jerk ramps in and out of it (a little
+  // conservative for small speed changes that never reach full braking)
+  float rampTime = (jerk > 0) ? acceleration / jerk : 0;
+  return (fromVelocity * fromVelocity - toVelocity * toVelocity) / (2 * acceleration) +
+         (fromVelocity + toVelocity) * rampTime / 2;
+}
+
+// Highest velocity that can still brake to the end velocity in this distance
+static float allowedVelocity(const MotionProfile& profile, float remaining) {
+  if (remaining <= 0) return profile.endVelocity;
+  
+  // Solve brakingDistance(v, endVelocity) = remaining for v
+  float e = profile.endVelocity;
+  float rampTime = (profile.jerk > 0) ? profile.acceleration / profile.jerk : 0;
+  float a = 1 / (2 * profile.acceleration);
+  float b = rampTime / 2;
+  float c = -(remaining + e * e / (2 * profile.acceleration) - e * rampTime / 2);
+  return (-b + sqrt(b * b - 4 * a * c)) / (2 * a);
+}
+
+void startMotionProfile(MotionProfile& profile, float distance_mm, float startVelocity,
+                        float maxVelocity, float endVelocity, float acceleration, float jerk) {
+  profile.distance = distance_mm;
+  profile.maxVelocity = maxVelocity;
+  profile.endVelocity = (endVelocity < maxVelocity) ? endVelocity : maxVelocity;
+  profile.acceleration = acceleration;
+  profile.jerk = jerk;
+  
+  profile.position = 0;
+  profile.velocity = startVelocity;
+  profile.accel = 0;
+  profile.finished = distance_mm <= 0;
+}
+
+// Longest step the profile is integrated with
+const float PROFILE_STEP_S = 0.002;
+
+// Velocity the profile aims for with this much distance left
+static float targetVelocity(const MotionProfile& profile, float remaining) {
+  float target = allowedVelocity(profile, remaining);
+  if (target > profile.maxVelocity) target = profile.maxVelocity;
+  
+  // Never crawl towards a stop - the last millimeters run at a small speed
+  float floor = (profile.endVelocity > PROFILE_FINAL_SPEED_MM_S) ? profile.endVelocity : PROFILE_FINAL_SPEED_MM_S;
+  if (target < floor) target = floor;
+  return target;
+}
+
+static void stepMotionProfile(MotionProfile& profile, float dt) {
+  float remaining = profile.distance - profile.position;
+  float target = targetVelocity(profile, remaining);
+  
+  // On the braking curve the target itself falls; follow that slope
+  // instead of trailing the curve by a jerk ramp
+  float slope = (targetVelocity(profile, remaining - profile.velocity * dt) - target) / dt;
+  
+  // Approach the target velocity over one jerk ramp, within the limits
+  float rampTime = (profile.jerk > 0) ? profile.acceleration / profile.jerk : 0;
+  float wanted = (target - profile.velocity) / ((rampTime > dt) ? rampTime : dt) + slope;
+  if (wanted > profile.acceleration) wanted = profile.acceleration;
+  if (wanted < -profile.acceleration) wanted = -profile.acceleration;
+  
+  if (profile.jerk > 0) {
+    float step = profile.jerk * dt;
+    if (wanted > profile.accel + step) wanted = profile.accel + step;
+    if (wanted < profile.accel - step) wanted = profile.accel - step;
+  }
+  profile.accel = wanted;
+  
+  float previous = profile.velocity;
+  profile.velocity += profile.accel * dt;
+  if (profile.velocity < 0) profile.velocity = 0;
+  profile.position += (previous + profile.velocity) / 2 * dt;
+  
+  if (profile.position >= profile.distance) {
+    profile.position = profile.distance;
+    profile.velocity = profile.endVelocity;
+    profile.accel = 0;
+    profile.finished = true;
+  }
+}
+
+void updateMotionProfile(MotionProfile& profile, float dt) {
+  // Long ticks are split so the profile never steps past its braking point
+  while (!profile.finished && dt > 0) {
+    float step = (dt > PROFILE_STEP_S) ? PROFILE_STEP_S : dt;
+    stepMotionProfile(profile, step);
+    dt -= step;
+  }
+}
+
+float motionProfileSeconds(float distance_mm, float startVelocity, float maxVelocity,
+                           float endVelocity, float acceleration, float jerk) {
+  MotionProfile profile;
+  startMotionProfile(profile, distance_mm, startVelocity, maxVelocity, endVelocity,
+                     acceleration, jerk);
+  
+  // The final speed floor keeps every profile moving to its target
+  float seconds = 0;
+  while (!profile.finished) {
+    stepMotionProfile(profile, PROFILE_STEP_S);
+    seconds += PROFILE_STEP_S;
+  }
+  return seconds;
+}
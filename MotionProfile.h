@@ -0,0 +1,75 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+/**
+ * @brief Motion Profile Module
+ *
+ * Generates the position and velocity setpoints of a straight move:
+ * - Trapezoidal velocity profile (jerk = 0) or S-curve (jerk limited)
+ * - Configurable maximum velocity, acceleration and jerk
+ * - Nonzero start and end velocities, so chained moves do not stop
+ *
+ * The profile is advanced once per control tick by the elapsed time and
+ * always brakes early enough to reach the end velocity at the target.
+ * This module does not depend on Arduino.h so it can also be built on a
+ * host machine.
+ */
+
+struct MotionProfile {
+  float distance;      // Target distance (mm)
+  float maxVelocity;   // Cruise velocity (mm/s)
+  float endVelocity;   // Velocity at the target (mm/s)
+  float acceleration;  // Acceleration and braking limit (mm/s²)
+  float jerk;          // Jerk limit (mm/s³), 0 for a trapezoidal profile
+
+  float position;      // Position setpoint (mm)
+  float velocity;      // Velocity setpoint (mm/s)
+  float accel;         // Acceleration setpoint (mm/s²)
+  bool finished;       // Target reached
+};
+
+/**
+ * @brief Start a new straight move profile
+ * @param profile Profile to initialize
+ * @param distance_mm Distance to travel
+ * @param startVelocity Velocity at the start (mm/s), e.g. the end velocity of a chained move
+ * @param maxVelocity Cruise velocity (mm/s)
+ * @param endVelocity Velocity at the target (mm/s)
+ * @param acceleration Acceleration and braking limit (mm/s²)
+ * @param jerk Jerk limit (mm/s³), 0 for a trapezoidal profile
+ */
+void startMotionProfile(MotionProfile& profile, float distance_mm, float startVelocity,
+                        float maxVelocity, float endVelocity, float acceleration, float jerk);
+
+/**
+ * @brief Advance the profile by one control tick
+ * @param profile Profile to advance
+ * @param dt Elapsed time in seconds
+ */
+void updateMotionProfile(MotionProfile& profile, float dt);
+
+/**
+ * @brief Distance needed to slow down from one velocity to another
+ * @param fromVelocity Current velocity (mm/s)
+ * @param toVelocity Final velocity (mm/s)
+ * @param acceleration Braking limit (mm/s²)
+ * @param jerk Jerk limit (mm/s³), 0 for none
+ * @return Distance in mm
+ */
+float brakingDistance(float fromVelocity, float toVelocity, float acceleration, float jerk);
+
+/**
+ * @brief Time a straight move profile takes from start to target
+ * Runs the profile with the same steps a move advances it by
+ * @param distance_mm Distance to travel
+ * @param startVelocity Velocity at the start (mm/s)
+ * @param maxVelocity Cruise velocity (mm/s)
+ * @param endVelocity Velocity at the target (mm/s)
+ * @param acceleration Acceleration and braking limit (mm/s²)
+ * @param jerk Jerk limit (mm/s³), 0 for a trapezoidal profile
+ * @return Duration in seconds
+ */
+float motionProfileSeconds(float distance_mm, float startVelocity, float maxVelocity,
+                           float endVelocity, float acceleration, float jerk);
+
+#endif // MOTION_PROFILE_H
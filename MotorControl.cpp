@@ -1,43 +1,165 @@
 #include "MotorControl.h"
 #include <Arduino.h>
 
+// Bridge input pins in LEDC channel order
+const int MOTOR_PINS[4] = {LEFT_MOTOR_PIN1, LEFT_MOTOR_PIN2, RIGHT_MOTOR_PIN1, RIGHT_MOTOR_PIN2};
+
+#ifdef ESP32
+
+#include <driver/ledc.h>
+
+// Low speed mode exists on every ESP32 variant. All four channels run on
+// one timer, so their cycles start together
+const ledc_mode_t MOTOR_LEDC_MODE = LEDC_LOW_SPEED_MODE;
+const ledc_timer_t MOTOR_LEDC_TIMER = LEDC_TIMER_0;
+
+static void initOutputs() {
+  ledc_timer_config_t timer;
+  memset(&timer, 0, sizeof(timer));
+  timer.speed_mode = MOTOR_LEDC_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)MOTOR_PWM_BITS;
+  timer.timer_num = MOTOR_LEDC_TIMER;
+  timer.freq_hz = MOTOR_PWM_FREQUENCY;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  if (ledc_timer_config(&timer) != ESP_OK) {
+    Serial.println("Motor PWM timer setup failed");
+  }
+  
+  for (int i = 0; i < 4; i++) {
+    ledc_channel_config_t channel;
+    memset(&channel, 0, sizeof(channel));
+    channel.gpio_num = MOTOR_PINS[i];
+    channel.speed_mode = MOTOR_LEDC_MODE;
+    channel.channel = (ledc_channel_t)i;
+    channel.intr_type = LEDC_INTR_DISABLE;
+    channel.timer_sel = MOTOR_LEDC_TIMER;
+    channel.duty = 0;
+    channel.hpoint = 0;
+    ledc_channel_config(&channel);
+  }
+}
+
+// Stage all duties first, then latch them back to back: each channel takes
+// its new duty at the start of its next cycle of the shared timer. The
+// latches take a few microseconds of the 50 us cycle, so the wheels
+// usually change in the same cycle, but that is not guaranteed
+static void writeOutputs(const int duty[4]) {
+  for (int i = 0; i < 4; i++) {
+    ledc_set_duty(MOTOR_LEDC_MODE, (ledc_channel_t)i, duty[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    ledc_update_duty(MOTOR_LEDC_MODE, (ledc_channel_t)i);
+  }
+}
+
+#else
+
+// Without LEDC (host simulator) the duties go out as 8-bit analogWrite()
+static void initOutputs() {
+  for (int i = 0; i < 4; i++) {
+    pinMode(MOTOR_PINS[i], OUTPUT);
+  }
+}
+
+static void writeOutputs(const int duty[4]) {
+  for (int i = 0; i < 4; i++) {
+    analogWrite(MOTOR_PINS[i], (int)round(duty[i] * 255.0 / MOTOR_PWM_FULL));
+  }
+}
+
+#endif
+
+// Last duties written, so a single motor can be changed with the other kept
+int motorDuty[4] = {0, 0, 0, 0};
+
+// Filtered pack voltage, read by the main loop for telemetry
+volatile float batteryVoltage = 0;
+float batteryScale = 1;
+int batterySampleCount = 0;
+
+static float readBatteryVoltage() {
+  return analogReadMilliVolts(BATTERY_ADC_PIN) * BATTERY_DIVIDER_RATIO / 1000.0;
+}
+
+static void setBatteryVoltage(float voltage) {
+  batteryVoltage = voltage;
+  batteryScale = (voltage >= BATTERY_MIN_V) ? BATTERY_NOMINAL_V / voltage : 1;
+}
+
+// One ADC sample every BATTERY_SAMPLE_INTERVAL motor updates keeps the
+// control tick short
+static void updateBattery() {
+  if (++batterySampleCount < BATTERY_SAMPLE_INTERVAL) return;
+  batterySampleCount = 0;
+  setBatteryVoltage(batteryVoltage + (readBatteryVoltage() - batteryVoltage) * BATTERY_FILTER);
+}
+
+// Fast decay drive: PWM on one input, the other held low
+static void setBridge(int* duty, float speed) {
+  speed = constrain(speed * batteryScale, -MAX_SPEED, MAX_SPEED);
+  int level = (int)round(fabs(speed) * MOTOR_PWM_FULL / MAX_SPEED);
+  duty[0] = (speed >= 0) ? level : 0;
+  duty[1] = (speed >= 0) ? 0 : level;
+}
+
 void initMotors() {
-  pinMode(LEFT_MOTOR_PIN1, OUTPUT);
-  pinMode(LEFT_MOTOR_PIN2, OUTPUT);
-  pinMode(RIGHT_MOTOR_PIN1, OUTPUT);
-  pinMode(RIGHT_MOTOR_PIN2, OUTPUT);
+  initOutputs();
+  
+  // Start the filter from a first reading
+  setBatteryVoltage(readBatteryVoltage());
+  Serial.print("Battery: ");
+  Serial.print(batteryVoltage, 2);
+  Serial.println(batteryVoltage >= BATTERY_MIN_V ? "V" : "V - no compensation");
   
   // Initialize motors to stopped state
-  stopMotors();
+  coastMotors();
 }
 
-void setMotorLeft(int speed) {
-  speed = constrain(speed, -255, 255);
-  if (speed >= 0) {
-    analogWrite(LEFT_MOTOR_PIN1, speed);
-    analogWrite(LEFT_MOTOR_PIN2, 0);
+void setMotorLeft(float speed) {
+  updateBattery();
+  setBridge(&motorDuty[0], speed);
+  writeOutputs(motorDuty);
+}
+
+void setMotorRight(float speed) {
+  updateBattery();
+  setBridge(&motorDuty[2], speed);
+  writeOutputs(motorDuty);
+}
+
+void setMotors(float left, float right) {
+  updateBattery();
+  setBridge(&motorDuty[0], left);
+  setBridge(&motorDuty[2], right);
+  writeOutputs(motorDuty);
+}
+
+void stopMotors() {
+  if (MOTOR_BRAKE_ON_STOP) {
+    brakeMotors();
   } else {
-    analogWrite(LEFT_MOTOR_PIN1, 0);
-    analogWrite(LEFT_MOTOR_PIN2, -speed);
+    coastMotors();
   }
 }
 
-void setMotorRight(int speed) {
-  speed = constrain(speed, -255, 255);
-  if (speed >= 0) {
-    analogWrite(RIGHT_MOTOR_PIN1, speed);
-    analogWrite(RIGHT_MOTOR_PIN2, 0);
-  } else {
-    analogWrite(RIGHT_MOTOR_PIN1, 0);
-    analogWrite(RIGHT_MOTOR_PIN2, -speed);
+void brakeMotors() {
+  updateBattery();
+  // LEDC takes duties from 0 to 2^bits inclusive, and 2^bits holds the
+  // input high for the whole cycle
+  for (int i = 0; i < 4; i++) {
+    motorDuty[i] = MOTOR_PWM_FULL;
   }
+  writeOutputs(motorDuty);
 }
 
-void setMotors(int left, int right) {
-  setMotorLeft(left);
-  setMotorRight(right);
+void coastMotors() {
+  updateBattery();
+  for (int i = 0; i < 4; i++) {
+    motorDuty[i] = 0;
+  }
+  writeOutputs(motorDuty);
 }
 
-void stopMotors() {
-  setMotors(0, 0);
+float getBatteryVoltage() {
+  return batteryVoltage;
 }
\ No newline at end of file
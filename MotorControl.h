@@ -8,34 +8,63 @@
  * 
  * This module handles all motor control operations including:
  * - Individual motor control (left/right)
- * - Combined motor control
- * - Motor stopping functionality
+ * - Combined motor control, both wheels updated together
+ * - Motor stopping by braking or coasting
+ * - Battery voltage measurement and compensation of the motor commands
+ * 
+ * On the ESP32 the H-bridge inputs are driven by LEDC channels sharing one
+ * timer at MOTOR_PWM_FREQUENCY with MOTOR_PWM_BITS of duty resolution.
+ * Commands keep the -MAX_SPEED to MAX_SPEED scale and are mapped onto the
+ * full duty range, so fractional commands are not lost.
+ * 
+ * A command gives the same motor voltage whatever the battery charge: it
+ * is scaled by BATTERY_NOMINAL_V over the filtered battery voltage, which
+ * is sampled on every BATTERY_SAMPLE_INTERVAL-th motor update.
  */
 
 /**
  * @brief Set left motor speed and direction
- * @param speed Motor speed (-255 to 255, negative for reverse)
+ * @param speed Motor speed (-MAX_SPEED to MAX_SPEED, negative for reverse)
  */
-void setMotorLeft(int speed);
+void setMotorLeft(float speed);
 
 /**
  * @brief Set right motor speed and direction
- * @param speed Motor speed (-255 to 255, negative for reverse)
+ * @param speed Motor speed (-MAX_SPEED to MAX_SPEED, negative for reverse)
  */
-void setMotorRight(int speed);
+void setMotorRight(float speed);
 
 /**
  * @brief Set both motors simultaneously
- * @param left Left motor speed (-255 to 255)
- * @param right Right motor speed (-255 to 255)
+ * Both new duties are latched back to back and usually take effect in
+ * the same PWM cycle
+ * @param left Left motor speed (-MAX_SPEED to MAX_SPEED)
+ * @param right Right motor speed (-MAX_SPEED to MAX_SPEED)
  */
-void setMotors(int left, int right);
+void setMotors(float left, float right);
 
 /**
  * @brief Stop both motors immediately
+ * Brakes or coasts as set by MOTOR_BRAKE_ON_STOP
  */
 void stopMotors();
 
+/**
+ * @brief Brake both motors by driving both bridge inputs high
+ */
+void brakeMotors();
+
+/**
+ * @brief Let both motors coast with both bridge inputs low
+ */
+void coastMotors();
+
+/**
+ * @brief Get the filtered battery voltage
+ * @return Pack voltage in V (below BATTERY_MIN_V if no pack is measured)
+ */
+float getBatteryVoltage();
+
 /**
  * @brief Initialize motor control pins
  * Should be called in setup()
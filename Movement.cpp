@@ -1,32 +1,305 @@
 #include "Movement.h"
 #include "Encoder.h"
-#include "MotorControl.h"
+#include "VelocityControl.h"
 #include "TOFSensors.h"
-#include "WallFollowing.h"
+#include "MotionProfile.h"
+#include "Odometry.h"
+#include "Calibration.h"
+#include "TraceRecorder.h"
 #include <Arduino.h>
 
-void moveForwardMM(float distance_mm) {
-  long targetCounts = 1.02 * distance_mm * COUNTS_PER_MM;
-  resetEncoders();
-  resetPID();
+// Current speed settings in mm/s (search speeds by default)
+float driveSpeed = BASE_SPEED_MM_S;
+float turnSpeed = TURN_SPEED_MM_S;
+
+// Velocity a chained move ended with, where the next move starts
+float rollingVelocity = 0;
+
+// Duration of the last ToF cycle, the look-ahead before a move's first reading
+float lastTofCycle_s = 0;
+
+// Speed difference (mm/s) per rad of steering error: every DRIVE_TICK_MS
+// on encoder ticks alone, and far lower once per ToF cycle
+const float HEADING_HOLD_GAIN = 3000.0;
+const float TOF_STEERING_GAIN = 500.0;
+
+// Lateral offset (mm) from the cell centerline worth one rad of heading error
+const float STEERING_LOOKAHEAD_MM = 150.0;
+
+// Wall sampling for the cell being entered
+WallSampleCallback wallSampleCallback = NULL;
+bool wallSamplingArmed = false;
+bool sampleSideWalls = true;
+float wallSampleCellCenter = 0;
+int leftWallSamples = 0;
+int frontWallSamples = 0;
+int rightWallSamples = 0;
+int leftWallVotes = 0;
+int frontWallVotes = 0;
+int rightWallVotes = 0;
+
+// Saved in trace checkpoints; the callback is set up again by setup()
+static TraceState driveSpeedState("movement.driveSpeed", &driveSpeed, sizeof(driveSpeed));
+static TraceState turnSpeedState("movement.turnSpeed", &turnSpeed, sizeof(turnSpeed));
+static TraceState rollingVelocityState("movement.rollingVelocity", &rollingVelocity, sizeof(rollingVelocity));
+static TraceState lastTofCycleState("movement.lastTofCycle", &lastTofCycle_s, sizeof(lastTofCycle_s));
+static TraceState wallSamplingArmedState("movement.wallSamplingArmed", &wallSamplingArmed, sizeof(wallSamplingArmed));
+static TraceState sampleSideWallsState("movement.sampleSideWalls", &sampleSideWalls, sizeof(sampleSideWalls));
+static TraceState wallSampleCellCenterState("movement.wallSampleCellCenter", &wallSampleCellCenter,
+                                            sizeof(wallSampleCellCenter));
+static TraceState leftWallSamplesState("movement.leftWallSamples", &leftWallSamples, sizeof(leftWallSamples));
+static TraceState frontWallSamplesState("movement.frontWallSamples", &frontWallSamples, sizeof(frontWallSamples));
+static TraceState rightWallSamplesState("movement.rightWallSamples", &rightWallSamples, sizeof(rightWallSamples));
+static TraceState leftWallVotesState("movement.leftWallVotes", &leftWallVotes, sizeof(leftWallVotes));
+static TraceState frontWallVotesState("movement.frontWallVotes", &frontWallVotes, sizeof(frontWallVotes));
+static TraceState rightWallVotesState("movement.rightWallVotes", &rightWallVotes, sizeof(rightWallVotes));
+
+// Side readings count on this stretch around the sampled cell's center
+const float WALL_SAMPLE_WINDOW_START = -CELL_SIZE_MM / 2.0 + WALL_SAMPLE_MARGIN_MM;
+const float WALL_SAMPLE_WINDOW_END = CELL_SIZE_MM / 2.0 - WALL_SAMPLE_MARGIN_MM;
+
+void setWallSampleCallback(WallSampleCallback callback) {
+  wallSampleCallback = callback;
+}
+
+void armWallSampling(float cellCenter_mm, bool sampleSides) {
+  wallSamplingArmed = true;
+  sampleSideWalls = sampleSides;
+  wallSampleCellCenter = cellCenter_mm;
+  leftWallSamples = 0;
+  frontWallSamples = 0;
+  rightWallSamples = 0;
+  leftWallVotes = 0;
+  frontWallVotes = 0;
+  rightWallVotes = 0;
+}
+
+// Majority of a wall's votes; a wall with too few readings is left to a
+// scan on arrival, as one noisy reading must not decide it
+static WallSample wallMajority(int votes, int samples) {
+  if (samples < MIN_WALL_SAMPLES) return WALL_UNSAMPLED;
+  return (2 * votes > samples) ? WALL_SAMPLED_CLOSED : WALL_SAMPLED_OPEN;
+}
+
+static void finishWallSampling() {
+  wallSamplingArmed = false;
+  if (wallSampleCallback == NULL) return;
+  
+  wallSampleCallback(wallMajority(leftWallVotes, leftWallSamples),
+                     wallMajority(frontWallVotes, frontWallSamples),
+                     wallMajority(rightWallVotes, rightWallSamples));
+}
+
+// Offset (mm) of the pose from the line the path follows on a heading,
+// positive to the left: the cells' centerline along a maze axis, and
+// the line through the cell edge midpoints on a diagonal
+static float centerlineOffset(float heading) {
+  Pose pose = getPose();
+  bool diagonal = (long)round(heading / (PI / 4)) % 2 != 0;
+  float spacing = diagonal ? CELL_SIZE_MM * 0.70711 : CELL_SIZE_MM;
+  float lateral = pose.x * -sin(heading) + pose.y * cos(heading);
+  return lateral - (floor(lateral / spacing) + 0.5) * spacing;
+}
+
+// Vote on the next cell's walls from the latest ToF read, which took
+// readDistance_mm and ended traveled_mm into the move
+static void sampleWalls(float traveled_mm, float readDistance_mm, float heading) {
+  if (!wallSamplingArmed) return;
+  
+  // A side wall reads about this far from where the pose is; a beam past
+  // an opening, even one grazing a neighbor's wall behind a post, further
+  float wallFace = CELL_SIZE_MM / 2.0 - WALL_THICKNESS_MM / 2 - SIDE_SENSOR_OFFSET_MM;
+  float offset = centerlineOffset(heading);
+  float leftWall = wallFace - offset + WALL_SAMPLE_TOLERANCE_MM;
+  float rightWall = wallFace + offset + WALL_SAMPLE_TOLERANCE_MM;
+  
+  // Where each sensor ranged, relative to the sampled cell's center: left,
+  // center and right range in turn, each a third of the read after the last
+  float sensorLag = readDistance_mm / 3;
+  float rightAt = traveled_mm - wallSampleCellCenter;
+  float centerAt = rightAt - sensorLag;
+  float leftAt = rightAt - 2 * sensorLag;
+  
+  // Side beams on the cell's wall segment, clear of the posts
+  if (leftAt + SIDE_SENSOR_LOOKAHEAD_MM >= WALL_SAMPLE_WINDOW_START &&
+      leftAt + SIDE_SENSOR_LOOKAHEAD_MM <= WALL_SAMPLE_WINDOW_END) {
+    leftWallSamples++;
+    if (getLeftDistance() < leftWall) leftWallVotes++;
+  }
+  if (rightAt + SIDE_SENSOR_LOOKAHEAD_MM >= WALL_SAMPLE_WINDOW_START &&
+      rightAt + SIDE_SENSOR_LOOKAHEAD_MM <= WALL_SAMPLE_WINDOW_END) {
+    rightWallSamples++;
+    if (getRightDistance() < rightWall) rightWallVotes++;
+  }
+  
+  // The front wall is in range from the previous cell's center on; an
+  // opening shows at least a cell further - split the difference
+  if (centerAt >= -CELL_SIZE_MM && centerAt <= WALL_SAMPLE_WINDOW_END) {
+    float frontWall = CELL_SIZE_MM / 2.0 - WALL_THICKNESS_MM / 2 - centerAt - FRONT_SENSOR_OFFSET_MM;
+    frontWallSamples++;
+    if (getCenterDistance() < frontWall + CELL_SIZE_MM / 2.0) frontWallVotes++;
+  }
+}
+
+// Fastest steady speed for a move's last MIN_WALL_SAMPLES ToF cycles that
+// still puts a reading of each wall from every one of them in its window,
+// when the move ends distance_mm from its start. The walls may call for a
+// stop at the cell center, so the robot must also be able to brake there
+static float wallSampleSpeed(float distance_mm, float cycle_s) {
+  float end = distance_mm - wallSampleCellCenter;
+  if (end > WALL_SAMPLE_WINDOW_END) end = WALL_SAMPLE_WINDOW_END;
+  float speed = (end < 0) ? sqrt(2 * DRIVE_ACCEL_MM_S2 * -end) : 0;
+  
+  // The center reading is a third of a cycle old when the read ends, the
+  // left one two thirds; a tenth to spare for cycles that run long
+  float frontWindow = end + CELL_SIZE_MM;
+  float frontSpeed = frontWindow / ((MIN_WALL_SAMPLES - 1 + 1 / 3.0) * cycle_s);
+  if (frontSpeed < speed) speed = frontSpeed;
+  if (sampleSideWalls) {
+    float sideWindow = end + SIDE_SENSOR_LOOKAHEAD_MM - WALL_SAMPLE_WINDOW_START;
+    if (sideWindow <= 0) return 0;
+    float sideSpeed = sideWindow / ((MIN_WALL_SAMPLES - 1 + 2 / 3.0) * cycle_s);
+    if (sideSpeed < speed) speed = sideSpeed;
+  }
+  return 0.9 * speed;
+}
+
+// Progress of a straight move from its start pose along its heading;
+// wall corrections of the pose move the end of the move with them
+static float progressAlong(const Pose& start, float heading) {
+  Pose now = getPose();
+  return (now.x - start.x) * cos(heading) + (now.y - start.y) * sin(heading);
+}
+
+// Advance the profile to now and return the forward speed in mm/s: the
+// setpoint velocity plus a correction for lagging behind (or running
+// ahead of) the setpoint position
+static float profileSpeed(MotionProfile& profile, unsigned long& lastTick, float traveled_mm) {
+  unsigned long now = millis();
+  traceClock(now);
+  updateMotionProfile(profile, (now - lastTick) / 1000.0);
+  lastTick = now;
+  
+  return profile.velocity + PROFILE_POSITION_GAIN * (profile.position - traveled_mm);
+}
+
+// Steering error of a straight move from the pose: the heading error
+// plus the offset from the line it follows. Positive errors are to the left
+static float steeringError(float heading) {
+  Pose pose = getPose();
+  return headingDifference(pose.theta, heading) + centerlineOffset(heading) / STEERING_LOOKAHEAD_MM;
+}
+
+// Follow the profile to the target on odometry alone, holding the
+// move's line. Returns false if the robot is held up on the way
+static bool driveProfileOnEncoders(MotionProfile& profile, unsigned long& lastTick,
+                                   const Pose& start, float heading, float distance_mm) {
+  float traveled;
+  while ((traveled = progressAlong(start, heading)) < distance_mm) {
+    if (profile.position - traveled > MOVE_MAX_LAG_MM) {
+      stopMoving();
+      Serial.println("Move blocked - fell behind its profile");
+      return false;
+    }
+    float speed = profileSpeed(profile, lastTick, traveled);
+    
+    float correction = HEADING_HOLD_GAIN * steeringError(heading);
+    float leftSpeed = constrain(speed + correction, 0, MAX_WHEEL_SPEED_MM_S);
+    float rightSpeed = constrain(speed - correction, 0, MAX_WHEEL_SPEED_MM_S);
+    setWheelVelocities(leftSpeed, rightSpeed, profile.accel);
+    
+    delay(DRIVE_TICK_MS);
+  }
+  return true;
+}
+
+// One ToF cycle of a straight move: correct the pose from the walls and
+// sample them. Returns false after an emergency stop on a wall ahead
+static bool tofCycle(const Pose& start, float heading, float& traveled) {
+  float readStart = getOdometryDistance();
+  readTOF();
+  
+  // Emergency stop if front wall too close
+  if (getCenterDistance() <= EMERGENCY_DISTANCE) { 
+    stopMoving(); 
+    wallSamplingArmed = false;
+    Serial.println("Emergency stop - front wall detected!");
+    return false; 
+  }
+  
+  // The readings are spread over the read, which can take a while
+  float readDistance = getOdometryDistance() - readStart;
+  correctPoseFromWalls(getLeftDistance(), getCenterDistance(), getRightDistance(), readDistance);
+  traveled = progressAlong(start, heading);
+  sampleWalls(traveled, readDistance, heading);
+  return true;
+}
+
+// Straight move steered on the wall-corrected pose that ends at
+// endVelocity, or stops at the target when it is 0. Returns false if it
+// was aborted on a wall ahead or held up
+static bool driveForward(float distance_mm, float endVelocity) {
+  bool stopAtEnd = endVelocity <= 0;
+  Pose start = getPose();
+  float heading = nearestHeading(start.theta, PI / 4);
+  float tofCycle_s = (lastTofCycle_s > 0) ? lastTofCycle_s : TOF_CYCLE_MS / 1000.0;
+  
+  // A chained move that samples walls ends with MIN_WALL_SAMPLES more ToF
+  // cycles at a steady speed, slow enough for all their readings to count
+  float finalCycles_mm = 0;
+  if (wallSamplingArmed && !stopAtEnd) {
+    float sampleSpeed = wallSampleSpeed(distance_mm, tofCycle_s);
+    if (sampleSpeed > PROFILE_FINAL_SPEED_MM_S) {
+      endVelocity = constrain(endVelocity, 0, sampleSpeed);
+      finalCycles_mm = constrain(MIN_WALL_SAMPLES * endVelocity * tofCycle_s, 0, distance_mm);
+    }
+  }
+  float profileDistance = distance_mm - finalCycles_mm;
+  
+  float maxVelocity = driveSpeed;
+  MotionProfile profile;
+  startMotionProfile(profile, profileDistance, rollingVelocity, maxVelocity, endVelocity,
+                     DRIVE_ACCEL_MM_S2, DRIVE_JERK_MM_S3);
+  unsigned long lastTick = millis();
+  traceClock(lastTick);
+  float cycleTraveled = 0;
+  bool cycleMeasured = false;
+  
   Serial.print("Moving forward ");
   Serial.print(distance_mm);
-  Serial.print("mm (Target counts: ");
-  Serial.print(targetCounts);
-  Serial.println(")");
+  Serial.println("mm");
 
-  while (getAverageEncoderCount() < targetCounts) {
-    readTOF();
-    
-    // Emergency stop if front wall too close
-    if (getCenterDistance() <= EMERGENCY_DISTANCE) { 
-      stopMotors(); 
-      Serial.println("Emergency stop - front wall detected!");
-      return; 
+  float traveled = 0;
+  while (traveled < profileDistance) {
+    // A ToF cycle takes long enough to overshoot the target: the end, and
+    // braking when the move slows down, run on encoder ticks alone
+    float cycleVelocity = cycleMeasured ? (traveled - cycleTraveled) / tofCycle_s : 0;
+    float velocity = (cycleVelocity > profile.velocity) ? cycleVelocity : profile.velocity;
+    cycleTraveled = traveled;
+    float approachDistance = velocity * tofCycle_s +
+                             brakingDistance(velocity, endVelocity, DRIVE_ACCEL_MM_S2, DRIVE_JERK_MM_S3);
+    if (profileDistance - traveled < approachDistance) {
+      // Brake from where the robot really is after a long cycle
+      profile.position = traveled;
+      profile.velocity = velocity;
+      if (!driveProfileOnEncoders(profile, lastTick, start, heading, profileDistance)) {
+        wallSamplingArmed = false;
+        return false;
+      }
+      break;
     }
     
-    // Use wall following PID during movement
-    wallFollowingPID();
+    if (!tofCycle(start, heading, traveled)) return false;
+    
+    // Steer on the wall-corrected pose around the profile speed
+    unsigned long cycleStart = lastTick;
+    float speed = profileSpeed(profile, lastTick, traveled);
+    float correction = TOF_STEERING_GAIN * steeringError(heading);
+    setWheelVelocities(constrain(speed + correction, 0, MAX_WHEEL_SPEED_MM_S),
+                       constrain(speed - correction, 0, MAX_WHEEL_SPEED_MM_S), profile.accel);
+    tofCycle_s = (lastTick - cycleStart) / 1000.0;
+    lastTofCycle_s = tofCycle_s;
+    cycleMeasured = true;
     
     Serial.print("LeftEnc: ");
     Serial.print(getLeftEncoderCount());
@@ -36,84 +309,504 @@ void moveForwardMM(float distance_mm) {
     //delay(5);
   }
   
-  stopMotors();
+  // Roll through the sampling window at the end speed
+  for (int i = 0; finalCycles_mm > 0 && i < MIN_WALL_SAMPLES; i++) {
+    float correction = TOF_STEERING_GAIN * steeringError(heading);
+    setWheelVelocities(constrain(endVelocity + correction, 0, MAX_WHEEL_SPEED_MM_S),
+                       constrain(endVelocity - correction, 0, MAX_WHEEL_SPEED_MM_S));
+    if (!tofCycle(start, heading, traveled)) return false;
+    profile.velocity = endVelocity;
+  }
+  
+  // Vote on what was sampled before the robot arrives
+  if (wallSamplingArmed) {
+    finishWallSampling();
+  }
+  
+  // Chained moves keep the last motor command and roll straight on
+  if (stopAtEnd) {
+    stopMoving();
+  } else {
+    rollingVelocity = profile.velocity;
+  }
   Serial.println("Forward movement completed");
+  return true;
 }
 
-void moveForwardWithWallFollowing(float distance_mm) {
-  // This is essentially the same as moveForwardMM since it already includes wall following
-  moveForwardMM(distance_mm);
+bool moveForwardMM(float distance_mm, bool stopAtEnd) {
+  // Chained moves hand over at cruise speed instead of stopping
+  return driveForward(distance_mm, stopAtEnd ? 0 : driveSpeed);
 }
 
-void turnLeft90() {
-  resetEncoders();
+void stopMoving() {
+  stopVelocityControl();
+  rollingVelocity = 0;
+}
+
+void setMovementSpeeds(float baseSpeed, float newTurnSpeed) {
+  driveSpeed = constrain(baseSpeed, 0, MAX_WHEEL_SPEED_MM_S);
+  turnSpeed = constrain(newTurnSpeed, 0, MAX_WHEEL_SPEED_MM_S);
   
-  Serial.print("Turning left 90° (Target counts: ");
-  Serial.print(COUNTS_PER_90_DEG);
-  Serial.println(")");
+  Serial.print("Speeds set - drive: ");
+  Serial.print(driveSpeed);
+  Serial.print(" | turn: ");
+  Serial.println(turnSpeed);
+}
 
-  while (getAverageEncoderCount() < 1.12 * COUNTS_PER_90_DEG) {
-    setMotors(-TURN_SPEED, TURN_SPEED);
-    
-    Serial.print("Left: ");
-    Serial.print(getLeftEncoderCount());
-    Serial.print(" | Right: ");
-    Serial.println(getRightEncoderCount());
+// Average center ToF readings while standing still
+static float averageFrontReading() {
+  long sum = 0;
+  for (int i = 0; i < FRONT_ALIGN_SAMPLES; i++) {
+    readTOF();
+    sum += getCenterDistance();
+  }
+  return (float)sum / FRONT_ALIGN_SAMPLES;
+}
+
+// Creep straight by a signed distance, slowing down on the way
+static void creepStraight(float distance_mm) {
+  Pose start = getPose();
+  float heading = nearestHeading(start.theta, PI / 2);
+  int direction = (distance_mm > 0) ? 1 : -1;
+  unsigned long startTime = millis();
+  traceClock(startTime);
+  float remaining;
+  
+  while ((remaining = direction * (distance_mm - progressAlong(start, heading))) > FRONT_ALIGN_TOLERANCE_MM) {
+    unsigned long now = millis();
+    traceClock(now);
+    if (now - startTime > FRONT_ALIGN_TIMEOUT_MS) break; // Stuck
     
-    delay(10);
+    float speed = constrain(FRONT_ALIGN_GAIN * remaining, PROFILE_FINAL_SPEED_MM_S, FRONT_ALIGN_SPEED_MM_S);
+    float correction = HEADING_HOLD_GAIN * headingDifference(getPose().theta, heading);
+    setWheelVelocities(direction * speed + correction, direction * speed - correction);
+    delay(DRIVE_TICK_MS);
   }
   
-  stopMotors();
-  Serial.println("Left turn completed");
+  stopMoving();
 }
 
-void turnRight90() {
-  resetEncoders();
+bool alignToFrontWall() {
+  stopMoving();
   
-  Serial.print("Turning right 90° (Target counts: ");
-  Serial.print(COUNTS_PER_90_DEG);
-  Serial.println(")");
+  float reading = averageFrontReading();
+  if (reading < FRONT_ALIGN_MIN_READING_MM) {
+    // Too close to measure - back up to the cell center on odometry first
+    Pose pose = getPose();
+    float heading = nearestHeading(pose.theta, PI / 2);
+    float along = pose.x * cos(heading) + pose.y * sin(heading);
+    float pastCenter = along - (round((along - CELL_SIZE_MM / 2.0) / CELL_SIZE_MM) * CELL_SIZE_MM + CELL_SIZE_MM / 2.0);
+    creepStraight(-pastCenter);
+    reading = averageFrontReading();
+  }
+  
+  if (reading > FRONT_WALL_THRESHOLD || reading < FRONT_ALIGN_MIN_READING_MM ||
+      !alignPoseToFrontWall(reading)) {
+    Serial.println("Front alignment skipped - no usable wall ahead");
+    return false;
+  }
+  
+  // Positive: short of the cell center, drive forward
+  float offset = reading - FRONT_ALIGN_DISTANCE_MM;
+  Serial.print("Aligning on front wall: ");
+  Serial.print(offset);
+  Serial.println("mm");
+  creepStraight(offset);
+  return true;
+}
 
-  while (getAverageEncoderCount() < 1.12 * COUNTS_PER_90_DEG) {
-    setMotors(TURN_SPEED, -TURN_SPEED);
-    
-    Serial.print("Left: ");
-    Serial.print(getLeftEncoderCount());
-    Serial.print(" | Right: ");
-    Serial.println(getRightEncoderCount());
+// Pivot in place from heading, as the caller read it, until the pose
+// heading reaches target, braking on the wheel arc that is left so the
+// turn does not overshoot. The target may lie outside (-PI, PI]
+static void pivotToHeading(float heading, float target) {
+  float halfTrack = getWheelBase() / 2;
+  int direction = (target < heading) ? 1 : -1; // 1 = clockwise
+  float remaining;
+  
+  while ((remaining = direction * (heading - target)) > 0) {
+    float speed = sqrt(2 * DRIVE_ACCEL_MM_S2 * remaining * halfTrack);
+    speed = constrain(speed, PROFILE_FINAL_SPEED_MM_S, turnSpeed);
+    setWheelVelocities(direction * speed, -direction * speed);
+    delay(DRIVE_TICK_MS);
     
-    delay(10);
+    // Follow the pose heading across its wrap at +-PI
+    heading += headingDifference(getPose().theta, heading);
   }
   
-  stopMotors();
+  stopMoving();
+}
+
+void turnLeft90() {
+  // Turn to the next maze axis, which also takes out heading drift
+  float heading = getPose().theta;
+  float target = nearestHeading(heading, PI / 2) + PI / 2;
+  
+  Serial.print("Turning left 90° (Target heading: ");
+  Serial.print(target * 180 / PI);
+  Serial.println("°)");
+
+  pivotToHeading(heading, target);
+  Serial.println("Left turn completed");
+}
+
+void turnRight90() {
+  float heading = getPose().theta;
+  float target = nearestHeading(heading, PI / 2) - PI / 2;
+  
+  Serial.print("Turning right 90° (Target heading: ");
+  Serial.print(target * 180 / PI);
+  Serial.println("°)");
+
+  pivotToHeading(heading, target);
   Serial.println("Right turn completed");
 }
 
 void turn180() {
-  resetEncoders();
+  float heading = getPose().theta;
+  float target = nearestHeading(heading, PI / 2) + PI;
   
-  Serial.print("Turning 180° (Target counts: ");
-  Serial.print(2 * COUNTS_PER_90_DEG);
-  Serial.println(")");
+  Serial.print("Turning 180° (Target heading: ");
+  Serial.print(target * 180 / PI);
+  Serial.println("°)");
+
+  // No backing into the wall behind to square up: the wheels slip
+  // against it, and the pose heading already ends the turn on the axis
+  pivotToHeading(heading, target);
+  Serial.println("180° turn completed");
+}
+
+// Length of one diagonal segment between adjacent cell edge midpoints
+const float DIAGONAL_SEGMENT_MM = CELL_SIZE_MM * 0.70711;
 
-  while (getAverageEncoderCount() < (1.25 * 2 * COUNTS_PER_90_DEG)) {
-    setMotors(-TURN_SPEED, TURN_SPEED);
+void pivotDegrees(int degrees) {
+  if (degrees == 0) return;
+  
+  // Clockwise turns lower the heading; diagonal headings are multiples of 45°
+  float heading = getPose().theta;
+  float target = nearestHeading(heading, PI / 4) - degrees * PI / 180;
+  
+  Serial.print("Pivoting ");
+  Serial.print(degrees);
+  Serial.print("° (Target heading: ");
+  Serial.print(target * 180 / PI);
+  Serial.println("°)");
+
+  pivotToHeading(heading, target);
+  Serial.println("Pivot completed");
+}
+
+// Drive an arc of the robot center at the turn speed, braking into it
+// from a rolling straight. Each wheel follows its own share of the arc:
+// the wheels run on circles half the effective wheel base outside and
+// inside the center's. Returns false if the robot is held up on the arc
+static bool driveArc(int degrees, float radius_mm) {
+  float arcLength = radius_mm * abs(degrees) * PI / 180.0;
+  float halfTrack = getWheelBase() / 2;
+  float outerRatio = (radius_mm + halfTrack) / radius_mm;
+  float innerRatio = (radius_mm - halfTrack) / radius_mm;
+  float leftRatio = (degrees > 0) ? outerRatio : innerRatio;
+  float rightRatio = (degrees > 0) ? innerRatio : outerRatio;
+  
+  // Clockwise turns lower the heading; the arc ends on the pose heading,
+  // which the wheels do not reach exactly where the profile ends
+  float heading = getPose().theta;
+  float target = nearestHeading(heading, PI / 4) - degrees * PI / 180;
+  int direction = (degrees > 0) ? 1 : -1;
+  
+  long startLeft, startRight;
+  getEncoderCounts(startLeft, startRight);
+  MotionProfile profile;
+  startMotionProfile(profile, arcLength, rollingVelocity, turnSpeed, turnSpeed,
+                     DRIVE_ACCEL_MM_S2, DRIVE_JERK_MM_S3);
+  unsigned long lastTick = millis();
+  traceClock(lastTick);
+  
+  Serial.print("Arc ");
+  Serial.print(degrees);
+  Serial.print("° radius ");
+  Serial.print(radius_mm);
+  Serial.print("mm (wheel ratio ");
+  Serial.print(leftRatio / rightRatio);
+  Serial.println(")");
+  
+  float center = 0;
+  while (direction * (heading - target) > 0) {
+    unsigned long now = millis();
+    traceClock(now);
+    updateMotionProfile(profile, (now - lastTick) / 1000.0);
+    lastTick = now;
     
-    Serial.print("Left: ");
-    Serial.print(getLeftEncoderCount());
-    Serial.print(" | Right: ");
-    Serial.println(getRightEncoderCount());
+    // Short integration steps keep the pose on the arc
+    updateOdometry();
+    long leftCount, rightCount;
+    getEncoderCounts(leftCount, rightCount);
+    float leftMM = (leftCount - startLeft) / getCountsPerMM();
+    float rightMM = (rightCount - startRight) / getCountsPerMM();
+    center = (leftMM + rightMM) / 2;
+    if (profile.position - center > MOVE_MAX_LAG_MM) {
+      stopMoving();
+      Serial.println("Arc blocked - fell behind its profile");
+      return false;
+    }
+    
+    float leftSpeed = profile.velocity * leftRatio +
+                      PROFILE_POSITION_GAIN * (profile.position * leftRatio - leftMM);
+    float rightSpeed = profile.velocity * rightRatio +
+                       PROFILE_POSITION_GAIN * (profile.position * rightRatio - rightMM);
+    setWheelVelocities(leftSpeed, rightSpeed, profile.accel);
     
-    delay(10);
+    delay(DRIVE_TICK_MS);
+    heading += headingDifference(getPose().theta, heading);
+  }
+  
+  // Leave the arc rolling straight: the next move starts with a ToF cycle
+  // on the last wheel command
+  setWheelVelocities(profile.velocity, profile.velocity);
+  rollingVelocity = profile.velocity;
+  return true;
+}
+
+bool smoothTurn(int degrees, float radius_mm, float entry_mm, float exit_mm, bool stopAtEnd) {
+  Serial.print("Smooth turn ");
+  Serial.print(degrees);
+  Serial.print("° (entry ");
+  Serial.print(entry_mm);
+  Serial.print("mm, exit ");
+  Serial.print(exit_mm);
+  Serial.println("mm)");
+  
+  // Arrive at the arc at the turn speed
+  if (entry_mm > 0 && !driveForward(entry_mm, turnSpeed)) {
+    return false;
   }
   
-  stopMotors();
-  delay(50);
-  // Additional backward movement for fine adjustment
-  setMotors(-TURN_SPEED, -TURN_SPEED);
-  delay(400);
-  stopMotors();
-  delay(50);
+  if (!driveArc(degrees, radius_mm)) {
+    return false;
+  }
   
-  Serial.println("180° turn completed");
-}
\ No newline at end of file
+  if (exit_mm > 0) {
+    if (!moveForwardMM(exit_mm, stopAtEnd)) return false;
+  } else if (stopAtEnd) {
+    stopMoving();
+  }
+  Serial.println("Smooth turn completed");
+  return true;
+}
+
+// Tangent length of an arc turn: from where the straights on either side
+// of it would meet to where the arc meets them
+static float arcTangentMM(int degrees) {
+  return SEARCH_TURN_RADIUS_MM * tan(abs(degrees) * PI / 360.0);
+}
+
+// How much of the straight before a MOTION_TURN primitive its arc takes,
+// from the edge midpoint the compiled path joins them at. Negative where
+// the arc starts past the edge midpoint, and the straight runs on into
+// the turn's cell
+static float turnEntryTrim(int angle, bool diagonal) {
+  int magnitude = abs(angle);
+  
+  if (magnitude == 45 || (magnitude == 90 && diagonal)) {
+    // Heading change on an edge midpoint
+    return arcTangentMM(magnitude);
+  }
+  if (magnitude == 135) {
+    // The orthogonal line and the diagonal one meet on the cell's far
+    // edge midpoint, a cell from the orthogonal side's edge midpoint and
+    // a diagonal segment from the diagonal side's
+    return arcTangentMM(135) - (diagonal ? DIAGONAL_SEGMENT_MM : CELL_SIZE_MM);
+  }
+  // 90 and 180: quarter arcs around cell centers, half a cell past the
+  // edge midpoint
+  return arcTangentMM(90) - CELL_SIZE_MM / 2.0;
+}
+
+// Run the arcs of one MOTION_TURN primitive, rolling in and out at the
+// turn speed. Returns false on an abort
+static bool executeTurnPrimitive(int angle) {
+  Serial.print("Smooth turn ");
+  Serial.print(angle);
+  Serial.println("°");
+  
+  if (abs(angle) == 180) {
+    int quarter = (angle > 0) ? 90 : -90;
+    return driveArc(quarter, SEARCH_TURN_RADIUS_MM) &&
+           driveForward(CELL_SIZE_MM - 2 * SEARCH_TURN_RADIUS_MM, turnSpeed) &&
+           driveArc(quarter, SEARCH_TURN_RADIUS_MM);
+  }
+  return driveArc(angle, SEARCH_TURN_RADIUS_MM);
+}
+
+// Move the path point of a plan from the edge midpoint a MOTION_TURN
+// primitive starts on to the one it ends on. Headings are pose angles
+static void advanceOverTurn(int angle, bool diagonal, float heading, float& x, float& y) {
+  float exitHeading = heading - angle * PI / 180;
+  int magnitude = abs(angle);
+  
+  if (magnitude == 90 && !diagonal) {
+    // In through one edge, out through the next
+    x += CELL_SIZE_MM / 2.0 * (cos(heading) + cos(exitHeading));
+    y += CELL_SIZE_MM / 2.0 * (sin(heading) + sin(exitHeading));
+  }
+  else if (magnitude == 135) {
+    // Along the in line to the far edge midpoint where it meets the out
+    // line, then along that one
+    float in = diagonal ? DIAGONAL_SEGMENT_MM : CELL_SIZE_MM;
+    float out = diagonal ? CELL_SIZE_MM : DIAGONAL_SEGMENT_MM;
+    x += in * cos(heading) + out * cos(exitHeading);
+    y += in * sin(heading) + out * sin(exitHeading);
+  }
+  else if (magnitude == 180) {
+    // Out of the neighboring cell, a cell to the side
+    float side = heading - (angle / 2) * PI / 180;
+    x += CELL_SIZE_MM * cos(side);
+    y += CELL_SIZE_MM * sin(side);
+  }
+  // 45° and diagonal 90° turns start and end on the same edge midpoint
+}
+
+void startMotionPlan(MotionPlanProgress& progress) {
+  // Follow the compiled path from the cell center the run starts on:
+  // straights end where the path says, not a length after the last
+  // primitive ended, so errors of the turns do not add up
+  Pose pose = getPose();
+  progress.next = 0;
+  progress.pathX = (floor(pose.x / CELL_SIZE_MM) + 0.5) * CELL_SIZE_MM;
+  progress.pathY = (floor(pose.y / CELL_SIZE_MM) + 0.5) * CELL_SIZE_MM;
+  progress.pathHeading = nearestHeading(pose.theta, PI / 2);
+  progress.diagonal = false;
+}
+
+bool executeMotionStep(const MotionPrimitive* plan, int count, MotionPlanProgress& progress) {
+  int i = progress.next++;
+  const MotionPrimitive& p = plan[i];
+  bool completed = true;
+  
+  switch (p.type) {
+    case MOTION_STRAIGHT:
+    case MOTION_DIAGONAL: {
+      // Straights roll into a following turn at the turn speed, its arc
+      // taking part of them, and stop before a pivot or at the end
+      progress.diagonal = (p.type == MOTION_DIAGONAL);
+      float length = p.length * (progress.diagonal ? DIAGONAL_SEGMENT_MM : CELL_SIZE_MM / 2.0);
+      progress.pathX += length * cos(progress.pathHeading);
+      progress.pathY += length * sin(progress.pathHeading);
+      
+      float trimEnd = 0;
+      float endVelocity = 0;
+      if (i + 1 < count && plan[i + 1].type == MOTION_TURN) {
+        trimEnd = turnEntryTrim(plan[i + 1].angle, progress.diagonal);
+        endVelocity = turnSpeed;
+      }
+      
+      Pose pose = getPose();
+      float distance = (progress.pathX - pose.x) * cos(progress.pathHeading) +
+                       (progress.pathY - pose.y) * sin(progress.pathHeading) - trimEnd;
+      if (distance > 0) {
+        completed = driveForward(distance, endVelocity);
+      }
+      break;
+    }
+    case MOTION_PIVOT:
+      pivotDegrees(p.angle);
+      progress.pathHeading -= p.angle * PI / 180;
+      break;
+    case MOTION_TURN:
+      completed = executeTurnPrimitive(p.angle);
+      advanceOverTurn(p.angle, progress.diagonal, progress.pathHeading, progress.pathX, progress.pathY);
+      progress.pathHeading -= p.angle * PI / 180;
+      // 45° and 135° turns switch between orthogonal and diagonal
+      if (abs(p.angle) == 45 || abs(p.angle) == 135) {
+        progress.diagonal = !progress.diagonal;
+      }
+      break;
+  }
+  
+  // Nothing after an aborted primitive starts where the plan expects
+  if (!completed) {
+    stopMoving();
+    Serial.print("Motion plan aborted at primitive ");
+    Serial.println(i);
+    return false;
+  }
+  
+  if (progress.next >= count) {
+    stopMoving();
+    Serial.println("Motion plan completed");
+  }
+  return true;
+}
+
+// Time of a pivot through this many degrees: the wheels run at the turn
+// speed until pivotToHeading()'s braking curve takes over
+static float pivotSeconds(int degrees, float speed) {
+  float halfTrack = getWheelBase() / 2;
+  float remaining = abs(degrees) * PI / 180.0 * halfTrack;
+  float seconds = 0;
+  while (remaining > 0) {
+    float wheelSpeed = constrain(sqrt(2 * DRIVE_ACCEL_MM_S2 * remaining), PROFILE_FINAL_SPEED_MM_S, speed);
+    remaining -= wheelSpeed * DRIVE_TICK_MS / 1000.0;
+    seconds += DRIVE_TICK_MS / 1000.0;
+  }
+  return seconds;
+}
+
+unsigned long motionPlanTimeMs(const MotionPrimitive* plan, int count, float baseSpeed, float planTurnSpeed) {
+  float seconds = 0;
+  bool diagonal = false;
+  float trimStart = 0;
+  float startVelocity = 0;
+  
+  for (int i = 0; i < count; i++) {
+    const MotionPrimitive& p = plan[i];
+    switch (p.type) {
+      case MOTION_STRAIGHT:
+      case MOTION_DIAGONAL: {
+        // The arcs on either side take part of the straight
+        diagonal = (p.type == MOTION_DIAGONAL);
+        float distance = p.length * (diagonal ? DIAGONAL_SEGMENT_MM : CELL_SIZE_MM / 2.0) - trimStart;
+        float endVelocity = 0;
+        if (i + 1 < count && plan[i + 1].type == MOTION_TURN) {
+          distance -= turnEntryTrim(plan[i + 1].angle, diagonal);
+          endVelocity = planTurnSpeed;
+        }
+        if (distance > 0) {
+          seconds += motionProfileSeconds(distance, startVelocity, baseSpeed, endVelocity,
+                                          DRIVE_ACCEL_MM_S2, DRIVE_JERK_MM_S3);
+        }
+        trimStart = 0;
+        startVelocity = 0;
+        break;
+      }
+      case MOTION_PIVOT:
+        seconds += pivotSeconds(p.angle, planTurnSpeed);
+        break;
+      case MOTION_TURN: {
+        // Arcs at the turn speed; a 180° turn runs a straight between
+        // its two quarter arcs
+        float arc = SEARCH_TURN_RADIUS_MM * abs(p.angle) * PI / 180.0;
+        if (abs(p.angle) == 180) arc += CELL_SIZE_MM - 2 * SEARCH_TURN_RADIUS_MM;
+        seconds += arc / planTurnSpeed;
+        
+        if (abs(p.angle) == 45 || abs(p.angle) == 135) {
+          diagonal = !diagonal;
+        }
+        trimStart = turnEntryTrim(p.angle, diagonal);
+        startVelocity = planTurnSpeed;
+        break;
+      }
+    }
+  }
+  return (unsigned long)(seconds * 1000);
+}
+
+void turnToNearestAxis() {
+  float heading = getPose().theta;
+  float target = nearestHeading(heading, PI / 2);
+  
+  Serial.print("Turning to the nearest axis (Target heading: ");
+  Serial.print(target * 180 / PI);
+  Serial.println("°)");
+  
+  pivotToHeading(heading, target);
+}
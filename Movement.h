@@ -2,6 +2,7 @@
 #define MOVEMENT_H
 
 #include "Config.h"
+#include "PathCompiler.h"
 
 /**
  * @brief Movement Module
@@ -9,39 +10,169 @@
  * This module handles all robot movement operations including:
  * - Forward movement with distance control
  * - Turning operations (left, right, 180 degrees)
- * - Movement with encoder feedback
+ * - Smooth arc turns that keep the robot moving
+ * - Movement on the odometry pose: moves end on the pose distance and
+ *   heading, so drift is corrected instead of restarting every move
+ * - Execution of compiled motion primitive sequences
  */
 
+// What the readings of one move say about a wall
+enum WallSample {
+  WALL_UNSAMPLED = -1,    // Fewer than MIN_WALL_SAMPLES readings
+  WALL_SAMPLED_OPEN = 0,
+  WALL_SAMPLED_CLOSED = 1
+};
+
+/**
+ * @brief Callback receiving the walls of the cell being entered
+ * Walls are relative to the robot's heading during the move
+ */
+typedef void (*WallSampleCallback)(WallSample leftWall, WallSample frontWall, WallSample rightWall);
+
+/**
+ * @brief Register the receiver of walls sampled while moving
+ * @param callback Function called once per armed move, or NULL
+ */
+void setWallSampleCallback(WallSampleCallback callback);
+
+/**
+ * @brief Sample the next cell's walls during the next forward move
+ * Every side reading taken while its beam was on the next cell's wall
+ * segment, and every front reading from the cell before it on, is a wall
+ * vote; the majority of a wall with at least MIN_WALL_SAMPLES votes is
+ * reported through the callback when the move ends. A chained move ends
+ * with MIN_WALL_SAMPLES ToF cycles slow enough to fall in the window
+ * @param cellCenter_mm Distance from the start of the move to the next cell center
+ * @param sampleSides Slow down enough for the side walls too; their
+ *                    window ends shortly after the post, so this costs time
+ */
+void armWallSampling(float cellCenter_mm, bool sampleSides = true);
+
 /**
  * @brief Move robot forward by specified distance
- * Uses encoder feedback to control distance accurately
+ * Follows an S-curve velocity profile (DRIVE_ACCEL_MM_S2, DRIVE_JERK_MM_S3)
+ * up to the drive speed, with odometry feedback on the profile position.
+ * The move runs along the nearest multiple of 45° to the start heading
  * @param distance_mm Distance to move in millimeters
+ * @param stopAtEnd If false, the motors keep running so the next move
+ *                  continues without stopping
+ * @return false if the move was aborted: an emergency stop on a wall
+ *         ahead, or a robot held up MOVE_MAX_LAG_MM behind its profile
+ *         (the robot is then stopped)
  */
-void moveForwardMM(float distance_mm);
+bool moveForwardMM(float distance_mm, bool stopAtEnd = true);
+
+/**
+ * @brief Snap the distance in the cell on the wall ahead
+ * Averages FRONT_ALIGN_SAMPLES center ToF readings while standing still,
+ * sets the pose from them and drives forward or back to where the reading
+ * is FRONT_ALIGN_DISTANCE_MM, the cell center. Call before a pivot turn
+ * so it starts from a known position
+ * @return false if there is no wall ahead or the reading does not fit the pose
+ */
+bool alignToFrontWall();
 
 /**
  * @brief Turn robot left by 90 degrees
- * Uses encoder feedback for accurate turning
+ * Ends on the pose heading at the next maze axis
  */
 void turnLeft90();
 
 /**
  * @brief Turn robot right by 90 degrees
- * Uses encoder feedback for accurate turning
+ * Ends on the pose heading at the next maze axis
  */
 void turnRight90();
 
 /**
  * @brief Turn robot 180 degrees
- * Uses encoder feedback for accurate turning
+ * Ends on the pose heading at the opposite maze axis
  */
 void turn180();
 
 /**
- * @brief Move forward with wall following during movement
- * Combines forward movement with wall following PID control
- * @param distance_mm Distance to move in millimeters
+ * @brief Turn on an arc without stopping
+ * Drives the entry straight, brakes to the turn speed and follows an arc
+ * whose wheel speed ratio follows from the radius and the wheel base, then
+ * drives the exit straight. Can start from a rolling straight.
+ * @param degrees Turn angle, positive = right (clockwise)
+ * @param radius_mm Arc radius of the robot center (above getWheelBase() / 2)
+ * @param entry_mm Straight before the arc
+ * @param exit_mm Straight after the arc
+ * @param stopAtEnd If false, the robot keeps rolling after the exit straight
+ * @return false if a straight or the arc was aborted (the robot is then stopped)
+ */
+bool smoothTurn(int degrees, float radius_mm, float entry_mm, float exit_mm, bool stopAtEnd = true);
+
+/**
+ * @brief Stop the motors and end a chained move
+ * Use instead of stopMotors() so the next move starts from standstill
+ */
+void stopMoving();
+
+/**
+ * @brief Set speeds used by all movement functions
+ * Search runs use BASE_SPEED_MM_S/TURN_SPEED_MM_S, speed runs faster settings
+ * @param baseSpeed Forward cruise speed in mm/s (up to MAX_WHEEL_SPEED_MM_S)
+ * @param turnSpeed Pivot wheel speed in mm/s (up to MAX_WHEEL_SPEED_MM_S)
+ */
+void setMovementSpeeds(float baseSpeed, float turnSpeed);
+
+/**
+ * @brief Turn robot in place by any multiple of 45 degrees
+ * Ends on the pose heading, counted from the nearest multiple of 45°
+ * @param degrees Turn angle, positive = right (clockwise)
+ */
+void pivotDegrees(int degrees);
+
+// Progress through a compiled run between primitives
+struct MotionPlanProgress {
+  int next;           // Primitive to run next
+  float pathX;        // Point of the compiled path the last primitive ended on (mm)
+  float pathY;
+  float pathHeading;  // Heading of the compiled path there (rad)
+  bool diagonal;      // The path runs diagonally there
+};
+
+/**
+ * @brief Start a compiled run from the cell center the robot stands on
+ * @param progress Receives the start of the run
+ */
+void startMotionPlan(MotionPlanProgress& progress);
+
+/**
+ * @brief Drive the next primitive of a compiled run
+ * Runs the primitives produced by compilePath() one per call, so the
+ * caller keeps its loop going between them. Straights and diagonals run
+ * to the compiled path's points and hand over to a following turn at the
+ * turn speed; every turn, 45 and 135 degrees included, is driven on arcs.
+ * Only pivot primitives, an aborted primitive and the last one stop the
+ * robot
+ * @param plan Motion primitive array
+ * @param count Number of primitives
+ * @param progress Run progress from startMotionPlan(), advanced by one
+ * @return false if the primitive was aborted
+ */
+bool executeMotionStep(const MotionPrimitive* plan, int count, MotionPlanProgress& progress);
+
+/**
+ * @brief Time the executor takes for a compiled run
+ * Prices each primitive the way executeMotionStep() drives it: straights
+ * and diagonals on the motion profile, less what the arcs next to them
+ * take, arcs at the turn speed and pivots on their braking curve
+ * @param plan Motion primitive array
+ * @param count Number of primitives
+ * @param baseSpeed Cruise speed of the straights (mm/s)
+ * @param planTurnSpeed Arc speed and pivot wheel speed (mm/s)
+ * @return Estimated run time in milliseconds, from a stop to a stop
+ */
+unsigned long motionPlanTimeMs(const MotionPrimitive* plan, int count, float baseSpeed, float planTurnSpeed);
+
+/**
+ * @brief Pivot onto the nearest maze axis
+ * Squares the robot up after a move that ended off the axes, e.g. an
+ * aborted diagonal
  */
-void moveForwardWithWallFollowing(float distance_mm);
+void turnToNearestAxis();
 
 #endif // MOVEMENT_H
\ No newline at end of file
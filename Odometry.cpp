@@ -0,0 +1,234 @@
+#include "Odometry.h"
+#include "Encoder.h"
+#include "Calibration.h"
+#include "TraceRecorder.h"
+#include <Arduino.h>
+
+// Pose estimate, starting in the center of cell (0, 0) facing north
+Pose pose = {CELL_SIZE_MM / 2.0, CELL_SIZE_MM / 2.0, PI / 2};
+
+// Center distance driven since power-up
+float odometryDistance = 0;
+
+// Encoder counts the pose was last integrated to
+long odometryLeft = 0;
+long odometryRight = 0;
+
+// Saved in trace checkpoints
+static TraceState poseState("odometry.pose", &pose, sizeof(pose));
+static TraceState odometryDistanceState("odometry.distance", &odometryDistance, sizeof(odometryDistance));
+static TraceState odometryLeftState("odometry.left", &odometryLeft);
+static TraceState odometryRightState("odometry.right", &odometryRight);
+
+// Keep the heading in (-PI, PI]: a heading that grows with every turn
+// loses float resolution over a long run
+static float wrapHeading(float theta) {
+  return headingDifference(theta, 0);
+}
+
+void setPose(float x_mm, float y_mm, float theta) {
+  pose.x = x_mm;
+  pose.y = y_mm;
+  pose.theta = wrapHeading(theta);
+  getEncoderCounts(odometryLeft, odometryRight);
+}
+
+void updateOdometry() {
+  long left, right;
+  getEncoderCounts(left, right);
+  float leftMM = (left - odometryLeft) / getCountsPerMM();
+  float rightMM = (right - odometryRight) / getCountsPerMM();
+  odometryLeft = left;
+  odometryRight = right;
+  
+  // Integrate along the heading halfway through the step
+  float distance = (leftMM + rightMM) / 2;
+  float rotation = (rightMM - leftMM) / getWheelBase();
+  float heading = pose.theta + rotation / 2;
+  pose.x += distance * cos(heading);
+  pose.y += distance * sin(heading);
+  pose.theta = wrapHeading(pose.theta + rotation);
+  odometryDistance += distance;
+}
+
+Pose getPose() {
+  updateOdometry();
+  return pose;
+}
+
+float getOdometryDistance() {
+  updateOdometry();
+  return odometryDistance;
+}
+
+float nearestHeading(float theta, float step) {
+  return round(theta / step) * step;
+}
+
+float headingDifference(float a, float b) {
+  float difference = fmod(a - b, 2 * PI);
+  if (difference > PI) difference -= 2 * PI;
+  if (difference <= -PI) difference += 2 * PI;
+  return difference;
+}
+
+// Correct the lateral coordinate (along the left normal nx, ny) from one
+// side reading taken lag_mm ago. side is 1 for the left sensor, -1 for
+// the right one
+static void correctFromSideWall(int distance, int side, float lag_mm,
+                                float nx, float ny, float error) {
+  if (distance >= OPENING_THRESHOLD) return;
+  
+  // Where the robot was at the reading
+  float lateral = pose.x * nx + pose.y * ny - lag_mm * sin(error);
+  
+  // Beams next to a post can graze it or the end of a wall across
+  float along = pose.x * ny - pose.y * nx - lag_mm * cos(error) + SIDE_SENSOR_LOOKAHEAD_MM;
+  float fromEdge = along - round(along / CELL_SIZE_MM) * CELL_SIZE_MM;
+  if (fabs(fromEdge) < POSE_POST_CLEARANCE_MM) return;
+  
+  // The nearest wall line on that side: wall faces sit half a wall
+  // thickness inside the cell edges
+  float edge = (side > 0) ? (floor(lateral / CELL_SIZE_MM) + 1) * CELL_SIZE_MM
+                          : floor(lateral / CELL_SIZE_MM) * CELL_SIZE_MM;
+  float face = edge - side * WALL_THICKNESS_MM / 2;
+  float measured = face - side * (SIDE_SENSOR_OFFSET_MM + distance) * cos(error);
+  float residual = measured - lateral;
+  if (fabs(residual) > POSE_WALL_TOLERANCE_MM) return;
+  
+  // A lateral error that keeps coming back means the heading is off:
+  // the heading takes a small share of every residual, which averages
+  // out the sensor noise over many readings
+  pose.x += POSE_SIDE_GAIN * residual * nx;
+  pose.y += POSE_SIDE_GAIN * residual * ny;
+  pose.theta = wrapHeading(pose.theta + residual / POSE_HEADING_LENGTH_MM);
+}
+
+// Correct the coordinate along the axis (ux, uy) from a front reading
+// taken lag_mm ago, by gain times the error. Returns false if the
+// reading does not match a wall face near the estimate
+static bool correctFromFrontWall(float distance, float lag_mm, float gain,
+                                 float ux, float uy, float error) {
+  float along = pose.x * ux + pose.y * uy - lag_mm;
+  float reach = (FRONT_SENSOR_OFFSET_MM + distance) * cos(error);
+  float edge = round((along + reach + WALL_THICKNESS_MM / 2) / CELL_SIZE_MM) * CELL_SIZE_MM;
+  float measured = edge - WALL_THICKNESS_MM / 2 - reach;
+  if (fabs(measured - along) > POSE_WALL_TOLERANCE_MM) return false;
+  
+  float correction = gain * (measured - along);
+  pose.x += correction * ux;
+  pose.y += correction * uy;
+  return true;
+}
+
+// Distance along a beam from origin (ox, oy) in direction (dx, dy) to the
+// face of the wall line crossing nearest to reach_mm. Walls only stand on
+// the cell edges; the beam meets the lines of one axis at spacing along
+// its normal (nx, ny), on the wall face it sees first. Sets second to the
+// distance of the crossing closest to reach after that one, on this axis
+static float nearestCrossing(float ox, float oy, float dx, float dy, float nx, float ny,
+                             float reach_mm, float& second) {
+  float along = ox * nx + oy * ny;
+  float step = dx * nx + dy * ny; // Normal component of the beam, per mm
+  float best = -1;
+  second = -1;
+  if (fabs(step) < 0.1) return best;
+  
+  int direction = (step > 0) ? 1 : -1;
+  int first = (direction > 0) ? (int)floor(along / CELL_SIZE_MM) + 1 : (int)ceil(along / CELL_SIZE_MM) - 1;
+  for (int k = first; ; k += direction) {
+    float face = k * CELL_SIZE_MM - direction * WALL_THICKNESS_MM / 2;
+    float s = (face - along) / step;
+    if (s > reach_mm + CELL_SIZE_MM) break;
+    if (s <= 0) continue;
+    if (best < 0 || fabs(s - reach_mm) < fabs(best - reach_mm)) {
+      second = best;
+      best = s;
+    } else if (second < 0 || fabs(s - reach_mm) < fabs(second - reach_mm)) {
+      second = s;
+    }
+  }
+  return best;
+}
+
+// Correct the pose from one side reading on a diagonal, taken lag_mm
+// ago. side is 1 for the left sensor, -1 for the right one. The beam
+// crosses the cell edges of both axes at 45°: the reading only counts if
+// exactly one wall face along it is near it, and then corrects the pose
+// along that wall's normal
+static void correctFromDiagonalSideWall(int distance, int side, float lag_mm) {
+  if (distance >= POSE_DIAGONAL_RANGE_MM) return;
+  
+  // Where the sensor was at the reading, and where its beam points
+  float hx = cos(pose.theta), hy = sin(pose.theta);
+  float dx = -side * hy, dy = side * hx;
+  float ox = pose.x + (SIDE_SENSOR_LOOKAHEAD_MM - lag_mm) * hx;
+  float oy = pose.y + (SIDE_SENSOR_LOOKAHEAD_MM - lag_mm) * hy;
+  float reach = SIDE_SENSOR_OFFSET_MM + distance;
+  
+  float secondX, secondY;
+  float crossingX = nearestCrossing(ox, oy, dx, dy, 1, 0, reach, secondX);
+  float crossingY = nearestCrossing(ox, oy, dx, dy, 0, 1, reach, secondY);
+  bool onX = crossingX >= 0 && (crossingY < 0 || fabs(crossingX - reach) < fabs(crossingY - reach));
+  float crossing = onX ? crossingX : crossingY;
+  if (crossing < 0 || fabs(crossing - reach) > POSE_DIAGONAL_TOLERANCE_MM) return;
+  
+  // Any other face near the reading could be the one it saw: a post, or
+  // the next wall through an opening
+  float others[3] = {secondX, secondY, onX ? crossingY : crossingX};
+  for (int i = 0; i < 3; i++) {
+    if (others[i] >= 0 && fabs(others[i] - reach) < 2 * POSE_DIAGONAL_TOLERANCE_MM + WALL_THICKNESS_MM) return;
+  }
+  
+  // A reading longer than expected puts the robot further from the wall
+  float nx = onX ? 1 : 0, ny = onX ? 0 : 1;
+  float shift = -(reach - crossing) * (dx * nx + dy * ny);
+  pose.x += POSE_DIAGONAL_GAIN * shift * nx;
+  pose.y += POSE_DIAGONAL_GAIN * shift * ny;
+  
+  // The heading takes a share of the lateral part, as on a maze axis
+  pose.theta = wrapHeading(pose.theta + shift * (-hy * nx + hx * ny) / POSE_HEADING_LENGTH_MM);
+}
+
+void correctPoseFromWalls(int leftDistance, int centerDistance, int rightDistance, float readDistance_mm) {
+  updateOdometry();
+  
+  // The sensors range left, center, right in turn, each reading is
+  // a third of the read older than the next
+  float sensorLag = readDistance_mm / 3;
+  
+  // On a diagonal the side beams cross the walls at 45°
+  float diagonalHeading = nearestHeading(pose.theta - PI / 4, PI / 2) + PI / 4;
+  if (fabs(pose.theta - diagonalHeading) <= POSE_MAX_HEADING_ERROR) {
+    correctFromDiagonalSideWall(leftDistance, 1, 2 * sensorLag);
+    correctFromDiagonalSideWall(rightDistance, -1, 0);
+    return;
+  }
+  
+  // Beams far off the wall normals hit the walls at a slant
+  float axisHeading = nearestHeading(pose.theta, PI / 2);
+  float error = pose.theta - axisHeading;
+  if (fabs(error) > POSE_MAX_HEADING_ERROR) return;
+  
+  float ux = round(cos(axisHeading));
+  float uy = round(sin(axisHeading));
+  
+  correctFromSideWall(leftDistance, 1, 2 * sensorLag, -uy, ux, error);
+  correctFromSideWall(rightDistance, -1, 0, -uy, ux, error);
+  
+  // Front wall: the distance along the heading, as it was when the center
+  // sensor ranged
+  if (centerDistance < POSE_FRONT_RANGE_MM) {
+    correctFromFrontWall(centerDistance, sensorLag, POSE_FRONT_GAIN, ux, uy, error);
+  }
+}
+
+bool alignPoseToFrontWall(float centerDistance) {
+  updateOdometry();
+  float axisHeading = nearestHeading(pose.theta, PI / 2);
+  float error = pose.theta - axisHeading;
+  if (fabs(error) > POSE_MAX_HEADING_ERROR) return false;
+  
+  return correctFromFrontWall(centerDistance, 0, 1.0, round(cos(axisHeading)),
+                              round(sin(axisHeading)), error);
+}
@@ -0,0 +1,100 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include "Config.h"
+
+/**
+ * @brief Odometry Module
+ *
+ * This module keeps a continuous pose estimate of the robot in the maze:
+ * - Integrates the signed encoder deltas of both wheels (midpoint rule)
+ *   using the calibrated wheel diameter and wheel base (Calibration.h)
+ * - Corrects the lateral position and heading from side walls and the
+ *   distance along the heading from front walls whenever they are seen
+ * - Keeps a running driven distance that is never reset
+ *
+ * The pose is in the maze frame: x east and y north in mm from the
+ * south-west corner of cell (0, 0), theta counter-clockwise from east in
+ * radians. Theta is kept in (-PI, PI]; turns that cross PI follow it
+ * with headingDifference().
+ *
+ * Encoder counts are read through the trace, so the pose is updated on
+ * the main thread and a replay reproduces it exactly.
+ */
+
+struct Pose {
+  float x;      // East (mm)
+  float y;      // North (mm)
+  float theta;  // Heading, counter-clockwise from east (rad, kept in (-PI, PI])
+};
+
+/**
+ * @brief Place the robot, e.g. in the center of the start cell
+ * Also restarts the integration from the current encoder counts, so call
+ * it again after resetEncoders()
+ * @param x_mm East coordinate
+ * @param y_mm North coordinate
+ * @param theta Heading, counter-clockwise from east (rad)
+ */
+void setPose(float x_mm, float y_mm, float theta);
+
+/**
+ * @brief Integrate the encoder counts since the last update
+ * The get functions below update first, so this is only needed to keep
+ * the integration steps short
+ */
+void updateOdometry();
+
+/**
+ * @brief Get the current pose estimate
+ * @return Pose in the maze frame
+ */
+Pose getPose();
+
+/**
+ * @brief Get the distance the robot center has driven
+ * Signed (backing up counts down) and never reset; moves measure their
+ * progress as the difference to their start
+ * @return Driven distance in mm
+ */
+float getOdometryDistance();
+
+/**
+ * @brief Correct the pose from the latest ToF readings
+ * Only used while the heading is within POSE_MAX_HEADING_ERROR of a maze
+ * axis or a diagonal; readings that do not match a wall face near the
+ * estimate (openings, posts seen at a slant) are ignored. On a diagonal
+ * only side readings that match exactly one wall face count
+ * @param leftDistance Left ToF reading (mm)
+ * @param centerDistance Center ToF reading (mm)
+ * @param rightDistance Right ToF reading (mm)
+ * @param readDistance_mm Distance driven during the readTOF() call that
+ *                        took the readings (left, center, right in turn)
+ */
+void correctPoseFromWalls(int leftDistance, int centerDistance, int rightDistance, float readDistance_mm);
+
+/**
+ * @brief Set the distance along the heading from a front wall
+ * For a reading averaged while standing still: the pose takes the
+ * measured distance as it is, instead of a share of the error
+ * @param centerDistance Center ToF reading (mm)
+ * @return false if the heading is off the maze axes or the reading does
+ *         not match a wall face near the estimate (pose unchanged)
+ */
+bool alignPoseToFrontWall(float centerDistance);
+
+/**
+ * @brief Round a heading to the nearest multiple of a step
+ * @param theta Heading (rad)
+ * @param step Step, e.g. PI / 2 for the maze axes
+ * @return Nearest multiple of step
+ */
+float nearestHeading(float theta, float step);
+
+/**
+ * @brief Signed difference between two headings
+ * @return a - b wrapped into (-PI, PI]
+ */
+float headingDifference(float a, float b);
+
+#endif // ODOMETRY_H
@@ -0,0 +1,203 @@
+#include "PathCompiler.h"
+#include "Config.h"
+
+// Intermediate items: line segments between edge midpoints and the
+// heading changes between them (in 45° units, positive = clockwise)
+enum RawKind : uint8_t { RAW_ORTHO, RAW_DIAG, RAW_TURN, RAW_PIVOT };
+
+struct RawItem {
+  uint8_t kind;
+  int8_t value; // Length for segments, 45° units for turns
+};
+
+// A route step list of N cells produces at most 4 items per cell
+const int MAX_RAW_ITEMS = 4 * MAZE_ROWS * MAZE_COLS + 4;
+
+static RawItem raw[MAX_RAW_ITEMS];
+static int rawCount = 0;
+static int lastHeading = -1;
+
+static int wrapUnits(int units) {
+  // Normalize a 45° unit difference to -3..4
+  units = ((units % 8) + 8) % 8;
+  return (units > 4) ? units - 8 : units;
+}
+
+static bool pushRaw(uint8_t kind, int value) {
+  if(rawCount >= MAX_RAW_ITEMS) return false;
+  raw[rawCount].kind = kind;
+  raw[rawCount].value = value;
+  rawCount++;
+  return true;
+}
+
+// Append a segment on heading (0-7, 45° steps clockwise from North),
+// merging it with the previous one when the heading is unchanged
+static bool pushSegment(int heading, int length) {
+  uint8_t kind = (heading & 1) ? RAW_DIAG : RAW_ORTHO;
+  
+  if(rawCount > 0 && heading == lastHeading && raw[rawCount - 1].kind == kind &&
+     raw[rawCount - 1].value + length <= 127) {
+    raw[rawCount - 1].value += length;
+    return true;
+  }
+  
+  if(lastHeading >= 0 && rawCount > 0 && raw[rawCount - 1].kind != RAW_PIVOT &&
+     heading != lastHeading) {
+    if(!pushRaw(RAW_TURN, wrapUnits(heading - lastHeading))) return false;
+  }
+  
+  lastHeading = heading;
+  return pushRaw(kind, length);
+}
+
+static bool emit(MotionPrimitive* plan, int& count, int maxPrimitives,
+                 uint8_t type, int angle, int length) {
+  if(count >= maxPrimitives) return false;
+  plan[count].type = type;
+  plan[count].angle = angle;
+  plan[count].length = length;
+  count++;
+  return true;
+}
+
+// Orthogonal-only run: straights between 90° turns taken in each turn cell
+static int compileOrthogonal(const uint8_t* route, int steps,
+                             MotionPrimitive* plan, int count, int maxPrimitives) {
+  int halves = 1; // Center of the start cell to its exit edge
+  
+  for(int i = 0; i + 1 < steps; i++) {
+    int in = route[i] & 3;
+    int out = route[i + 1] & 3;
+    int change = (out - in + 4) % 4;
+    
+    if(change == 0) {
+      halves += 2;
+      continue;
+    }
+    
+    if(change == 2) {
+      // Dead end: drive to the center and spin around
+      if(!emit(plan, count, maxPrimitives, MOTION_STRAIGHT, 0, halves + 1) ||
+         !emit(plan, count, maxPrimitives, MOTION_PIVOT, 180, 0)) return -1;
+      halves = 1;
+      continue;
+    }
+    
+    if(halves > 0 && !emit(plan, count, maxPrimitives, MOTION_STRAIGHT, 0, halves)) return -1;
+    if(!emit(plan, count, maxPrimitives, MOTION_TURN, (change == 1) ? 90 : -90, 0)) return -1;
+    halves = 0;
+  }
+  
+  // Entry edge of the goal cell to its center
+  if(!emit(plan, count, maxPrimitives, MOTION_STRAIGHT, 0, halves + 1)) return -1;
+  return count;
+}
+
+static bool isTurn(int i, int units) {
+  return i < rawCount && raw[i].kind == RAW_TURN && raw[i].value == units;
+}
+
+static bool isSegment(int i, uint8_t kind, int length) {
+  return i < rawCount && raw[i].kind == kind && (length == 0 || raw[i].value == length);
+}
+
+int compilePath(const uint8_t* route, int steps, int startDir, bool allowDiagonals,
+                MotionPrimitive* plan, int maxPrimitives) {
+  rawCount = 0;
+  lastHeading = -1;
+  if(steps <= 0) return 0;
+  
+  // Face the first step before moving
+  int count = 0;
+  int startTurn = wrapUnits((route[0] - startDir) * 2);
+  if(startTurn != 0 && !emit(plan, count, maxPrimitives, MOTION_PIVOT, startTurn * 45, 0)) {
+    return -1;
+  }
+  
+  if(!allowDiagonals) {
+    return compileOrthogonal(route, steps, plan, count, maxPrimitives);
+  }
+  
+  // Center of the start cell to its exit edge
+  bool ok = pushSegment(route[0] * 2, 1);
+  
+  // Every intermediate cell, from entry edge to exit edge
+  for(int i = 0; i + 1 < steps && ok; i++) {
+    int in = route[i] & 3;
+    int out = route[i + 1] & 3;
+    int change = (out - in + 4) % 4;
+    
+    if(change == 0) {
+      ok = pushSegment(in * 2, 2);
+    } else if(change == 2) {
+      // Dead end: drive in, spin around and drive back out
+      ok = pushSegment(in * 2, 1) && pushRaw(RAW_PIVOT, 4);
+      lastHeading = out * 2;
+      ok = ok && pushRaw(RAW_ORTHO, 1);
+    } else {
+      // Cut the corner from edge midpoint to edge midpoint
+      ok = pushSegment((in * 2 + (change == 1 ? 1 : -1) + 8) % 8, 1);
+    }
+  }
+  
+  // Entry edge of the goal cell to its center
+  ok = ok && pushSegment(route[steps - 1] * 2, 1);
+  if(!ok) return -1;
+  
+  // Fuse turn patterns into single smooth turn primitives
+  for(int i = 0; i < rawCount; i++) {
+    if(count >= maxPrimitives) return -1;
+    MotionPrimitive& p = plan[count];
+    p.length = 0;
+    p.angle = 0;
+    
+    const RawItem& item = raw[i];
+    if(item.kind == RAW_ORTHO || item.kind == RAW_DIAG) {
+      p.type = (item.kind == RAW_ORTHO) ? MOTION_STRAIGHT : MOTION_DIAGONAL;
+      p.length = item.value;
+      count++;
+      continue;
+    }
+    
+    if(item.kind == RAW_PIVOT) {
+      p.type = MOTION_PIVOT;
+      p.angle = item.value * 45;
+      count++;
+      continue;
+    }
+    
+    p.type = MOTION_TURN;
+    int t = item.value;
+    bool fromOrtho = (i > 0 && raw[i - 1].kind == RAW_ORTHO);
+    
+    if(fromOrtho && (t == 1 || t == -1) && isSegment(i + 1, RAW_DIAG, 1)) {
+      if(isTurn(i + 2, t) && isSegment(i + 3, RAW_ORTHO, 0)) {
+        // One corner cut: smooth 90° turn through the cell
+        p.angle = 2 * t * 45;
+        i += 2;
+      } else if(isTurn(i + 2, 2 * t) && isSegment(i + 3, RAW_DIAG, 1) &&
+                isTurn(i + 4, t) && isSegment(i + 5, RAW_ORTHO, 0)) {
+        // Two corners the same way: U-turn through two cells
+        p.angle = 4 * t * 45;
+        i += 4;
+      } else if(isTurn(i + 2, 2 * t) && isSegment(i + 3, RAW_DIAG, 0)) {
+        // Orthogonal into diagonal through one cell
+        p.angle = 3 * t * 45;
+        i += 2;
+      } else {
+        p.angle = t * 45;
+      }
+    } else if(!fromOrtho && (t == 2 || t == -2) && isSegment(i + 1, RAW_DIAG, 1) &&
+              isTurn(i + 2, t / 2) && isSegment(i + 3, RAW_ORTHO, 0)) {
+      // Diagonal out to orthogonal through one cell
+      p.angle = 3 * (t / 2) * 45;
+      i += 2;
+    } else {
+      p.angle = t * 45;
+    }
+    count++;
+  }
+  
+  return count;
+}
@@ -0,0 +1,60 @@
+#ifndef PATH_COMPILER_H
+#define PATH_COMPILER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Path Compiler Module
+ * 
+ * Turns a known cell route into a compact sequence of motion primitives:
+ * - Long straights spanning several cells
+ * - Smooth 45°/90°/135°/180° turns
+ * - Diagonal runs across zig-zag (staircase) sections
+ * 
+ * The route is followed through the midpoints of the cell edges, so
+ * consecutive opposite turns become a single diagonal line.
+ * This module does not depend on Arduino.h so it can also be built on a
+ * host machine.
+ */
+
+// Motion primitive types
+enum MotionType : uint8_t {
+  MOTION_STRAIGHT = 0, // Orthogonal straight, length in half cells
+  MOTION_DIAGONAL = 1, // Diagonal straight, length in cell-corner segments
+  MOTION_TURN     = 2, // Turn taken while moving through the maze
+  MOTION_PIVOT    = 3  // Turn in place at the current position
+};
+
+/**
+ * @brief One step of a compiled run
+ * Turn angles are in degrees, positive = right (clockwise), matching the
+ * direction numbering 0=UP, 1=RIGHT, 2=DOWN, 3=LEFT
+ * 
+ * MOTION_TURN geometry, starting and ending on cell edge midpoints:
+ * - 90:  orthogonal to orthogonal within one cell
+ * - 180: orthogonal U-turn through two cells
+ * - 45:  orthogonal to diagonal or back, at an edge midpoint
+ * - 135: orthogonal to diagonal (or back) through one cell
+ * - 90 while diagonal: diagonal to diagonal at an edge midpoint
+ */
+struct MotionPrimitive {
+  uint8_t type;   // MotionType
+  int16_t angle;  // Turn angle for MOTION_TURN / MOTION_PIVOT
+  uint8_t length; // Length for MOTION_STRAIGHT / MOTION_DIAGONAL
+};
+
+/**
+ * @brief Compile a cell route into motion primitives
+ * The run starts and ends at cell centers
+ * @param route Absolute direction of every cell step (0=UP ... 3=LEFT)
+ * @param steps Number of cell steps in the route
+ * @param startDir Heading of the robot before the run
+ * @param allowDiagonals If false, zig-zags are run as orthogonal 90° turns
+ * @param plan Output primitive array
+ * @param maxPrimitives Capacity of the output array
+ * @return Number of primitives written, or -1 if the plan does not fit
+ */
+int compilePath(const uint8_t* route, int steps, int startDir, bool allowDiagonals,
+                MotionPrimitive* plan, int maxPrimitives);
+
+#endif // PATH_COMPILER_H
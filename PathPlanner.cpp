@@ -0,0 +1,205 @@
+#include "PathPlanner.h"
+#include "MotionProfile.h"
+#include <math.h>
+#include <stdlib.h>
+
+// One search state per (cell, heading)
+const int NUM_STATES = MAZE_ROWS * MAZE_COLS * 4;
+const unsigned long NO_TIME = 0xFFFFFFFFUL;
+const uint16_t NO_STATE = 0xFFFF;
+const float QUARTER_TURN_RAD = 3.14159 / 2.0; // No Arduino PI on the host
+
+// Search buffers kept off the stack
+static unsigned long stateTime[NUM_STATES];
+static uint16_t stateParent[NUM_STATES];
+static uint16_t heap[NUM_STATES];
+static uint16_t heapPos[NUM_STATES];
+static int heapSize = 0;
+
+static inline int stateIndex(int x, int y, int heading) {
+  return ((y * MAZE_COLS) + x) * 4 + heading;
+}
+
+unsigned long straightTimeMs(int cells) {
+  // Cell center to cell center, less the arc tangents at both ends, handing
+  // over to the turns at the turn speed
+  float distance = cells * (float)CELL_SIZE_MM - 2.0 * SEARCH_TURN_RADIUS_MM;
+  float seconds = motionProfileSeconds(distance, FAST_TURN_SPEED_MM_S, FAST_RUN_SPEED_MM_S,
+                                       FAST_TURN_SPEED_MM_S, DRIVE_ACCEL_MM_S2, DRIVE_JERK_MM_S3);
+  return (unsigned long)(seconds * 1000.0 + 0.5);
+}
+
+unsigned long turnTimeMs(int quarters) {
+  float turnSpeed = FAST_TURN_SPEED_MM_S;
+  float seconds;
+  if(quarters == 1) {
+    // Quarter arc around the cell center at the turn speed
+    seconds = QUARTER_TURN_RAD * SEARCH_TURN_RADIUS_MM / turnSpeed;
+  } else {
+    // Stop, pivot in place and restart: the ramps to and from rest and the
+    // arc tangents the straights left out, then the pivot wheel travel
+    // and its braking
+    float pivotTravel = QUARTER_TURN_RAD * DEFAULT_WHEEL_BASE_MM;
+    seconds = turnSpeed / DRIVE_ACCEL_MM_S2 +
+              2.0 * SEARCH_TURN_RADIUS_MM / turnSpeed +
+              pivotTravel / turnSpeed + turnSpeed / (2.0 * DRIVE_ACCEL_MM_S2);
+  }
+  return (unsigned long)(seconds * 1000.0 + 0.5);
+}
+
+// Open directions of a cell as a bit mask (bit 0=North ... bit 3=West)
+static uint8_t openMask(const WallMap& map, int x, int y, bool knownOnly) {
+  uint8_t open = ~map.wallMask(x, y) & 0x0F;
+  
+  if(knownOnly) {
+    open &= map.knownMask(x, y);
+  }
+  return open;
+}
+
+// Binary min-heap on stateTime with decrease-key
+static void heapSwap(int a, int b) {
+  uint16_t t = heap[a];
+  heap[a] = heap[b];
+  heap[b] = t;
+  heapPos[heap[a]] = a;
+  heapPos[heap[b]] = b;
+}
+
+static void heapUp(int i) {
+  while(i > 0) {
+    int parent = (i - 1) / 2;
+    if(stateTime[heap[parent]] <= stateTime[heap[i]]) break;
+    heapSwap(i, parent);
+    i = parent;
+  }
+}
+
+static void heapDown(int i) {
+  while(true) {
+    int smallest = i;
+    int left = 2 * i + 1;
+    int right = left + 1;
+    if(left < heapSize && stateTime[heap[left]] < stateTime[heap[smallest]]) smallest = left;
+    if(right < heapSize && stateTime[heap[right]] < stateTime[heap[smallest]]) smallest = right;
+    if(smallest == i) break;
+    heapSwap(i, smallest);
+    i = smallest;
+  }
+}
+
+static int heapPop() {
+  int top = heap[0];
+  heapSize--;
+  if(heapSize > 0) {
+    heap[0] = heap[heapSize];
+    heapPos[heap[0]] = 0;
+    heapDown(0);
+  }
+  heapPos[top] = NO_STATE;
+  return top;
+}
+
+static void relax(int from, int to, unsigned long cost) {
+  unsigned long t = stateTime[from] + cost;
+  if(t >= stateTime[to]) return;
+  
+  bool queued = stateTime[to] != NO_TIME;
+  stateTime[to] = t;
+  stateParent[to] = from;
+  if(!queued) {
+    heap[heapSize] = to;
+    heapPos[to] = heapSize;
+    heapSize++;
+  }
+  if(heapPos[to] != NO_STATE) {
+    heapUp(heapPos[to]);
+  }
+}
+
+int planFastestRoute(const WallMap& map, const MazeRow goalRows[MAZE_ROWS],
+                     int startX, int startY, int startDir, bool knownOnly,
+                     uint8_t* route, int maxSteps, unsigned long* totalTimeMs) {
+  // Straight costs depend only on length - compute them once per plan
+  const int maxRun = (MAZE_ROWS > MAZE_COLS) ? MAZE_ROWS : MAZE_COLS;
+  unsigned long straightCost[maxRun + 1];
+  for(int n = 1; n <= maxRun; n++) {
+    straightCost[n] = straightTimeMs(n);
+  }
+  unsigned long turn90Cost = turnTimeMs(1);
+  unsigned long turn180Cost = turnTimeMs(2);
+  
+  for(int s = 0; s < NUM_STATES; s++) {
+    stateTime[s] = NO_TIME;
+    stateParent[s] = NO_STATE;
+    heapPos[s] = NO_STATE;
+  }
+  heapSize = 0;
+  
+  int start = stateIndex(startX, startY, startDir & 3);
+  stateTime[start] = 0;
+  heap[heapSize] = start;
+  heapPos[start] = heapSize;
+  heapSize++;
+  
+  int goalState = -1;
+  while(heapSize > 0) {
+    int s = heapPop();
+    int heading = s & 3;
+    int cell = s >> 2;
+    int x = cell % MAZE_COLS;
+    int y = cell / MAZE_COLS;
+    
+    // First goal state settled is the fastest arrival
+    if((goalRows[y] >> x) & 1) {
+      goalState = s;
+      break;
+    }
+    
+    // Arc through the cell, or pivot around in place
+    relax(s, stateIndex(x, y, (heading + 1) & 3), turn90Cost);
+    relax(s, stateIndex(x, y, (heading + 3) & 3), turn90Cost);
+    relax(s, stateIndex(x, y, (heading + 2) & 3), turn180Cost);
+    
+    // Straights of every length the known corridor allows
+    int runX = x;
+    int runY = y;
+    for(int n = 1; n <= maxRun; n++) {
+      if(!((openMask(map, runX, runY, knownOnly) >> heading) & 1)) break;
+      runX += DIR_DX[heading];
+      runY += DIR_DY[heading];
+      relax(s, stateIndex(runX, runY, heading), straightCost[n]);
+    }
+  }
+  
+  if(goalState < 0) {
+    return PLANNER_NO_ROUTE;
+  }
+  if(totalTimeMs) {
+    *totalTimeMs = stateTime[goalState];
+  }
+  
+  // Count cell steps back to the start, then fill the route from the end
+  int steps = 0;
+  for(int s = goalState; s != start; s = stateParent[s]) {
+    int p = stateParent[s];
+    steps += abs((s >> 2) % MAZE_COLS - (p >> 2) % MAZE_COLS) +
+             abs((s >> 2) / MAZE_COLS - (p >> 2) / MAZE_COLS);
+  }
+  if(steps > maxSteps) {
+    return PLANNER_NO_ROUTE;
+  }
+  
+  int i = steps;
+  for(int s = goalState; s != start; s = stateParent[s]) {
+    int p = stateParent[s];
+    if((p >> 2) == (s >> 2)) continue; // Turn in place
+    int n = abs((s >> 2) % MAZE_COLS - (p >> 2) % MAZE_COLS) +
+            abs((s >> 2) / MAZE_COLS - (p >> 2) / MAZE_COLS);
+    while(n--) {
+      route[--i] = s & 3;
+    }
+  }
+  
+  return steps;
+}
@@ -0,0 +1,64 @@
+#ifndef PATH_PLANNER_H
+#define PATH_PLANNER_H
+
+#include "Config.h"
+#include "MazeNavigation.h"
+#include <stdint.h>
+
+/**
+ * @brief Path Planner Module
+ * 
+ * Minimum-time route planning for the speed run:
+ * - Dijkstra search over (cell, heading) states
+ * - Costs derived from the speed run motion constants the executor drives
+ *   with (FAST_RUN_SPEED_MM_S, FAST_TURN_SPEED_MM_S, DRIVE_ACCEL_MM_S2,
+ *   DRIVE_JERK_MM_S3, SEARCH_TURN_RADIUS_MM): straights on the executor's
+ *   motion profile chained into 90° arcs at the turn speed, 180° turns as
+ *   a stop and pivot in place
+ * - The costs rank cell routes only: compilePath() turns the route into
+ *   diagonals and fused turns afterwards, so the run time is estimated
+ *   from those primitives with motionPlanTimeMs()
+ * 
+ * This module does not depend on Arduino.h so it can also be built on a
+ * host machine.
+ */
+
+// Return value when no route to the goal exists
+const int PLANNER_NO_ROUTE = -1;
+
+/**
+ * @brief Estimated time to drive a straight between two turns
+ * The straight runs between the arcs at both ends, from the turn speed
+ * to the turn speed. The first and last straights of a route are costed
+ * the same way; every route has one of each, so the route choice does
+ * not change
+ * @param cells Straight length in cells, cell center to cell center
+ * @return Estimated time in milliseconds
+ */
+unsigned long straightTimeMs(int cells);
+
+/**
+ * @brief Estimated time of a turn on a cell center
+ * @param quarters 1 for a 90° arc, 2 for a 180° pivot in place
+ * @return Estimated time in milliseconds
+ */
+unsigned long turnTimeMs(int quarters);
+
+/**
+ * @brief Plan the minimum-time route from a start pose to the goal
+ * @param map Wall map to plan on
+ * @param goalRows Goal bitboard: bit x of goalRows[y] marks goal cell (x, y)
+ * @param startX Start cell X coordinate
+ * @param startY Start cell Y coordinate
+ * @param startDir Start heading (0=UP, 1=RIGHT, 2=DOWN, 3=LEFT)
+ * @param knownOnly If true, only walls observed as open may be crossed
+ * @param route Output: absolute direction of every cell step
+ * @param maxSteps Capacity of the route array
+ * @param totalTimeMs Optional output: estimated route time in milliseconds
+ * @return Number of cell steps, or PLANNER_NO_ROUTE
+ */
+int planFastestRoute(const WallMap& map, const MazeRow goalRows[MAZE_ROWS],
+                     int startX, int startY, int startDir, bool knownOnly,
+                     uint8_t* route, int maxSteps, unsigned long* totalTimeMs);
+
+#endif // PATH_PLANNER_H
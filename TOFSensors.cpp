@@ -1,4 +1,5 @@
 #include "TOFSensors.h"
+#include "TraceRecorder.h"
 #include <Arduino.h>
 
 // Global distance variables
@@ -6,6 +7,11 @@ int distLeft = 2000;
 int distCenter = 2000;
 int distRight = 2000;
 
+// Saved in trace checkpoints
+static TraceState distLeftState("tof.left", &distLeft, sizeof(distLeft));
+static TraceState distCenterState("tof.center", &distCenter, sizeof(distCenter));
+static TraceState distRightState("tof.right", &distRight, sizeof(distRight));
+
 // Sensor objects
 Adafruit_VL53L0X loxLeft = Adafruit_VL53L0X();
 Adafruit_VL53L0X loxRight = Adafruit_VL53L0X();
@@ -73,6 +79,8 @@ void readTOF() {
   distLeft   = constrain(distLeft, 30, 2000);
   distCenter = constrain(distCenter, 25, 2000);
   distRight  = constrain(distRight, 30, 2000);
+  
+  traceTOF(distLeft, distCenter, distRight);
 }
 
 int getLeftDistance() {
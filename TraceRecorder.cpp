@@ -0,0 +1,790 @@
+#include "TraceRecorder.h"
+#include <Arduino.h>
+#include <string.h>
+
+#if TRACE_RECORDING
+// Built-in trace storage
+uint8_t traceStorage[TRACE_BUFFER_SIZE];
+#endif
+
+TraceMode traceMode = TRACE_OFF;
+uint8_t* traceBuffer = NULL;        // Recording
+const uint8_t* replayData = NULL;   // Replay
+size_t traceCapacity = 0;
+size_t traceLength = 0;
+size_t replayPosition = 0;
+
+// Recorded records form a ring after the base time record; the counters
+// keep growing and are taken modulo the ring size
+size_t ringHead = 0;                // Oldest record
+size_t ringTail = 0;                // End of the newest record
+
+// Time of the last record
+unsigned long traceClockMs = 0;
+
+// Time of the last record dropped from the ring
+unsigned long droppedClockMs = 0;
+
+// Last recorded values, stored as changes
+int unchangedEncoderReads = 0;
+long lastLeftCount = 0;
+long lastRightCount = 0;
+int lastLeftMotor = 0;
+int lastRightMotor = 0;
+
+bool stopOnMotorMismatch = true;
+TraceReplayStats replayStats;
+TraceReplayEndCallback replayEndCallback = NULL;
+
+// Time of the last checkpoint recorded
+bool checkpointRecorded = false;
+unsigned long lastCheckpointMs = 0;
+
+// Firmware state saved in checkpoints, sorted by name so the order does
+// not depend on the order the modules are initialized in
+enum TraceStateKind {
+  STATE_BYTES,
+  STATE_LONG,
+  STATE_UNSIGNED_LONG
+};
+
+struct TraceStateBlock {
+  const char* name;
+  void* data;
+  size_t size;
+  TraceStateKind kind;
+};
+
+const int MAX_TRACE_STATE_BLOCKS = 96;
+TraceStateBlock stateBlocks[MAX_TRACE_STATE_BLOCKS];
+int stateBlockCount = 0;
+
+// Recorder state at the start of a checkpoint: unchanged encoder reads,
+// encoder counts and motor commands
+const size_t CHECKPOINT_RECORDER_SIZE = 1 + 4 + 4 + 2 + 2;
+
+static void resetTraceState() {
+  traceLength = 0;
+  replayPosition = 0;
+  ringHead = 0;
+  ringTail = 0;
+  traceClockMs = 0;
+  droppedClockMs = 0;
+  unchangedEncoderReads = 0;
+  lastLeftCount = 0;
+  lastRightCount = 0;
+  lastLeftMotor = 0;
+  lastRightMotor = 0;
+  checkpointRecorded = false;
+  lastCheckpointMs = 0;
+  memset(&replayStats, 0, sizeof(replayStats));
+}
+
+// ================== Checkpoint state ==================
+
+static void addStateBlock(const char* name, void* data, size_t size, TraceStateKind kind) {
+  if (stateBlockCount >= MAX_TRACE_STATE_BLOCKS) return;
+  
+  int i = stateBlockCount++;
+  while (i > 0 && strcmp(stateBlocks[i - 1].name, name) > 0) {
+    stateBlocks[i] = stateBlocks[i - 1];
+    i--;
+  }
+  stateBlocks[i].name = name;
+  stateBlocks[i].data = data;
+  stateBlocks[i].size = size;
+  stateBlocks[i].kind = kind;
+}
+
+TraceState::TraceState(const char* name, void* data, size_t size) {
+  addStateBlock(name, data, size, STATE_BYTES);
+}
+
+TraceState::TraceState(const char* name, long* value) {
+  addStateBlock(name, value, 4, STATE_LONG);
+}
+
+TraceState::TraceState(const char* name, unsigned long* value) {
+  addStateBlock(name, value, 4, STATE_UNSIGNED_LONG);
+}
+
+// Bytes of a checkpoint after its length
+static size_t checkpointSize() {
+  size_t size = CHECKPOINT_RECORDER_SIZE;
+  for (int i = 0; i < stateBlockCount; i++) {
+    size += stateBlocks[i].size;
+  }
+  return size;
+}
+
+// Payload bytes after the record header, -1 for an unknown type;
+// TRACE_BYTES and TRACE_CHECKPOINT add the data length stored in their
+// first three bytes
+static int payloadSize(uint8_t type) {
+  switch (type) {
+    case TRACE_TIME:         return 4;
+    case TRACE_CLOCK:        return 0;
+    case TRACE_ENCODERS:     return 5;
+    case TRACE_ENCODERS_ABS: return 9;
+    case TRACE_TOF:          return 6;
+    case TRACE_MOTORS:       return 4;
+    case TRACE_DECISION:     return 4;
+    case TRACE_BYTES:        return 3;
+    case TRACE_CHECKPOINT:   return 3;
+    default:                 return -1;
+  }
+}
+
+// ================== Recording ==================
+
+static size_t ringSize() {
+  return traceCapacity - TRACE_RECORDS_START;
+}
+
+static uint8_t& ringByte(size_t offset) {
+  return traceBuffer[TRACE_RECORDS_START + offset % ringSize()];
+}
+
+static void put8(uint8_t value) {
+  ringByte(ringTail++) = value;
+}
+
+static void put16(uint16_t value) {
+  put8(value & 0xFF);
+  put8(value >> 8);
+}
+
+static void put32(uint32_t value) {
+  put16(value & 0xFFFF);
+  put16(value >> 16);
+}
+
+// Make room by dropping the oldest record; the base time record keeps
+// the time of the dropped records so the rest still have absolute times
+static void dropOldestRecord() {
+  uint8_t type = ringByte(ringHead);
+  size_t size = 3 + payloadSize(type);
+  if (type == TRACE_TIME) {
+    droppedClockMs = 0;
+    for (int i = 3; i >= 0; i--) droppedClockMs = (droppedClockMs << 8) | ringByte(ringHead + 3 + i);
+  } else {
+    droppedClockMs += ringByte(ringHead + 1) | (ringByte(ringHead + 2) << 8);
+  }
+  if (type == TRACE_BYTES || type == TRACE_CHECKPOINT) {
+    size += ringByte(ringHead + 4) | (ringByte(ringHead + 5) << 8);
+  }
+  ringHead += size;
+  
+  for (int i = 0; i < 4; i++) {
+    traceBuffer[TRACE_HEADER_SIZE + 3 + i] = (droppedClockMs >> (8 * i)) & 0xFF;
+  }
+  traceBuffer[5] |= TRACE_FLAG_WRAPPED;
+}
+
+// Write a record header, dropping old records when the buffer is full;
+// false if no record is being written
+static bool beginRecord(uint8_t type, size_t payload, unsigned long stamp) {
+  if (traceMode != TRACE_RECORD) return false;
+  
+  // Deltas cover about a minute; longer gaps get an absolute time first
+  bool absolute = stamp < traceClockMs || stamp - traceClockMs > 0xFFFF;
+  size_t needed = 3 + payload + (absolute ? 7 : 0);
+  if (needed > ringSize()) {
+    traceMode = TRACE_OFF;
+    Serial.println("Trace record larger than the buffer - recording stopped");
+    return false;
+  }
+  while (ringTail - ringHead + needed > ringSize()) {
+    dropOldestRecord();
+  }
+  
+  if (absolute) {
+    put8(TRACE_TIME);
+    put16(0);
+    put32(stamp);
+    traceClockMs = stamp;
+  }
+  
+  put8(type);
+  put16(stamp - traceClockMs);
+  traceClockMs = stamp;
+  return true;
+}
+
+void startTraceRecording(uint8_t* buffer, size_t capacity) {
+  if (traceMode != TRACE_OFF) return;
+  
+#if TRACE_RECORDING
+  if (buffer == NULL) {
+    buffer = traceStorage;
+    capacity = TRACE_BUFFER_SIZE;
+  }
+#endif
+  if (buffer == NULL || capacity <= TRACE_RECORDS_START) return;
+  
+  resetTraceState();
+  traceBuffer = buffer;
+  traceCapacity = capacity;
+  replayData = NULL;
+  
+  const uint8_t header[TRACE_RECORDS_START] = {
+    'M', 'T', 'R', 'C', TRACE_VERSION, 0 /* Flags */, MAZE_ROWS, MAZE_COLS,
+    TRACE_TIME, 0, 0, 0, 0, 0, 0 /* Base time */
+  };
+  memcpy(buffer, header, sizeof(header));
+  traceMode = TRACE_RECORD;
+}
+
+// ================== Replay ==================
+
+static uint8_t get8() {
+  return replayData[replayPosition++];
+}
+
+static uint16_t get16() {
+  uint16_t low = get8();
+  return low | ((uint16_t)get8() << 8);
+}
+
+static uint32_t get32() {
+  uint32_t low = get16();
+  return low | ((uint32_t)get16() << 16);
+}
+
+size_t traceRecordSize(const uint8_t* data, size_t length, size_t position) {
+  if (position + 3 > length) return 0;
+  
+  uint8_t type = data[position];
+  if (payloadSize(type) < 0) return 0;
+  
+  size_t size = 3 + payloadSize(type);
+  if (type == TRACE_BYTES || type == TRACE_CHECKPOINT) {
+    if (position + 6 > length) return 0;
+    size += data[position + 4] | (data[position + 5] << 8);
+  }
+  return (position + size <= length) ? size : 0;
+}
+
+// Size of the replayed record at this offset, 0 if it is cut off
+static size_t recordSize(size_t position) {
+  return traceRecordSize(replayData, traceLength, position);
+}
+
+static bool isInputRecord(int type) {
+  return type == TRACE_CLOCK || type == TRACE_ENCODERS || type == TRACE_ENCODERS_ABS ||
+         type == TRACE_TOF || type == TRACE_BYTES;
+}
+
+// Offset and type of the next input record, without consuming anything
+static size_t findInput(int* type) {
+  size_t position = replayPosition;
+  while (true) {
+    size_t size = recordSize(position);
+    if (size == 0) {
+      *type = 0;
+      return position;
+    }
+    if (isInputRecord(replayData[position])) {
+      *type = replayData[position];
+      return position;
+    }
+    position += size;
+  }
+}
+
+static void endReplay() {
+  traceMode = TRACE_OFF;
+  if (replayEndCallback != NULL) {
+    replayEndCallback();
+  }
+}
+
+static void divergeReplay(int expectedType, int foundType) {
+  replayStats.diverged = true;
+  replayStats.divergedAt = replayPosition;
+  replayStats.expectedType = expectedType;
+  replayStats.foundType = foundType;
+  endReplay();
+}
+
+// Consume a record header and advance the replay clock
+static void consumeHeader() {
+  get8();
+  traceClockMs += get16();
+  replayStats.records++;
+}
+
+// Type of the next record after time records, 0 at the end of the trace
+static int peekRecord() {
+  while (true) {
+    if (recordSize(replayPosition) == 0) return 0;
+    if (replayData[replayPosition] != TRACE_TIME) return replayData[replayPosition];
+  
+    consumeHeader();
+    traceClockMs = get32();
+  }
+}
+
+// Motor commands or decisions the firmware did not make
+static bool skipMissedOutputs() {
+  while (true) {
+    int type = peekRecord();
+    if (type == TRACE_MOTORS) {
+      replayStats.motorCommands++;
+      replayStats.motorMismatches++;
+      if (stopOnMotorMismatch) {
+        divergeReplay(0, type);
+        return false;
+      }
+    }
+    else if (type == TRACE_DECISION) {
+      replayStats.decisions++;
+      replayStats.decisionMismatches++;
+      if (stopOnMotorMismatch) {
+        divergeReplay(0, type);
+        return false;
+      }
+    }
+    else if (type == TRACE_CHECKPOINT) {
+      replayStats.checkpoints++;
+      replayStats.checkpointMismatches++;
+      if (stopOnMotorMismatch) {
+        divergeReplay(0, type);
+        return false;
+      }
+    }
+    else {
+      return true;
+    }
+    replayPosition += recordSize(replayPosition);
+    replayStats.records++;
+  }
+}
+
+// The recording may stop anywhere, even while storing an output: an
+// output past the end of the trace ends the replay
+static bool replayEnded() {
+  if (peekRecord() != 0) return false;
+  replayStats.finished = true;
+  endReplay();
+  return true;
+}
+
+// Move to the next input record, which must be of this type
+static bool expectInput(int type) {
+  if (!skipMissedOutputs()) return false;
+  
+  int found = peekRecord();
+  if (found == 0) {
+    replayStats.finished = true;
+    endReplay();
+    return false;
+  }
+  if (found != type) {
+    divergeReplay(type, found);
+    return false;
+  }
+  
+  consumeHeader();
+  unchangedEncoderReads = 0;
+  return true;
+}
+
+// Offset of the first checkpoint, with the trace time before it in
+// clock; 0 if the trace holds none
+static size_t findCheckpoint(const uint8_t* data, size_t length, unsigned long* clock) {
+  size_t position = TRACE_HEADER_SIZE;
+  size_t size;
+  *clock = 0;
+  while ((size = traceRecordSize(data, length, position)) != 0) {
+    if (data[position] == TRACE_CHECKPOINT) return position;
+    if (data[position] == TRACE_TIME) {
+      *clock = data[position + 3] | (data[position + 4] << 8) |
+               ((unsigned long)data[position + 5] << 16) | ((unsigned long)data[position + 6] << 24);
+    } else {
+      *clock += data[position + 1] | (data[position + 2] << 8);
+    }
+    position += size;
+  }
+  return 0;
+}
+
+bool startTraceReplay(const uint8_t* data, size_t length, bool stopOnMismatch) {
+  if (length < TRACE_HEADER_SIZE || memcmp(data, "MTRC", 4) != 0 ||
+      data[4] != TRACE_VERSION || data[6] != MAZE_ROWS || data[7] != MAZE_COLS) {
+    return false;
+  }
+  
+  // Without its start a trace can only begin at a checkpoint
+  bool wrapped = data[5] & TRACE_FLAG_WRAPPED;
+  unsigned long checkpointClock = 0;
+  size_t checkpoint = wrapped ? findCheckpoint(data, length, &checkpointClock) : 0;
+  if (wrapped && checkpoint == 0) {
+    return false;
+  }
+  
+  resetTraceState();
+  replayData = data;
+  traceLength = length;
+  replayPosition = TRACE_HEADER_SIZE;
+  stopOnMotorMismatch = stopOnMismatch;
+  traceMode = TRACE_REPLAY;
+  if (wrapped) {
+    replayPosition = checkpoint;
+    traceClockMs = checkpointClock;
+    replayStats.startedAt = checkpoint;
+    replayStats.startMs = checkpointClock + (data[checkpoint + 1] | (data[checkpoint + 2] << 8));
+    traceMode = TRACE_REPLAY_PENDING;
+  }
+  return true;
+}
+
+// ================== Hooks ==================
+
+void traceEncoders(long& left, long& right) {
+  if (traceMode == TRACE_RECORD) {
+    if (left == lastLeftCount && right == lastRightCount && unchangedEncoderReads < 255) {
+      unchangedEncoderReads++;
+      return;
+    }
+  
+    long deltaLeft = left - lastLeftCount;
+    long deltaRight = right - lastRightCount;
+    uint8_t unchanged = unchangedEncoderReads;
+    if (deltaLeft >= -32768 && deltaLeft <= 32767 && deltaRight >= -32768 && deltaRight <= 32767) {
+      if (!beginRecord(TRACE_ENCODERS, 5, millis())) return;
+      put8(unchanged);
+      put16(deltaLeft);
+      put16(deltaRight);
+    } else {
+      if (!beginRecord(TRACE_ENCODERS_ABS, 9, millis())) return;
+      put8(unchanged);
+      put32(left);
+      put32(right);
+    }
+    unchangedEncoderReads = 0;
+    lastLeftCount = left;
+    lastRightCount = right;
+  }
+  else if (traceMode == TRACE_REPLAY) {
+    // Reads before the next change return the previous counts, and so do
+    // the unrecorded reads between the last input and the last outputs
+    int type = 0;
+    size_t position = findInput(&type);
+    bool change = (type == TRACE_ENCODERS || type == TRACE_ENCODERS_ABS) &&
+                  replayData[position + 3] == unchangedEncoderReads;
+    bool outputsLeft = (type == 0 && position != replayPosition);
+    if ((type != 0 && !change) || outputsLeft) {
+      unchangedEncoderReads++;
+      left = lastLeftCount;
+      right = lastRightCount;
+      return;
+    }
+  
+    if (!expectInput(type == 0 ? TRACE_ENCODERS : type)) return;
+    get8();
+    if (type == TRACE_ENCODERS) {
+      lastLeftCount += (int16_t)get16();
+      lastRightCount += (int16_t)get16();
+    } else {
+      lastLeftCount = (int32_t)get32();
+      lastRightCount = (int32_t)get32();
+    }
+    left = lastLeftCount;
+    right = lastRightCount;
+  }
+}
+
+void traceTOF(int& left, int& center, int& right) {
+  if (traceMode == TRACE_RECORD) {
+    if (!beginRecord(TRACE_TOF, 6, millis())) return;
+    put16(left);
+    put16(center);
+    put16(right);
+    unchangedEncoderReads = 0;
+  }
+  else if (traceMode == TRACE_REPLAY) {
+    if (!expectInput(TRACE_TOF)) return;
+    left = get16();
+    center = get16();
+    right = get16();
+  }
+}
+
+void traceClock(unsigned long& now) {
+  if (traceMode == TRACE_RECORD) {
+    if (!beginRecord(TRACE_CLOCK, 0, now)) return;
+    unchangedEncoderReads = 0;
+  }
+  else if (traceMode == TRACE_REPLAY) {
+    if (!expectInput(TRACE_CLOCK)) return;
+    now = traceClockMs;
+  }
+}
+
+void traceBytes(void* data, size_t length, bool& valid) {
+  if (traceMode == TRACE_RECORD) {
+    size_t stored = valid ? length : 0;
+    if (!beginRecord(TRACE_BYTES, 3 + stored, millis())) return;
+    put8(valid);
+    put16(stored);
+    for (size_t i = 0; i < stored; i++) {
+      put8(((const uint8_t*)data)[i]);
+    }
+    unchangedEncoderReads = 0;
+  }
+  else if (traceMode == TRACE_REPLAY) {
+    size_t start = replayPosition;
+    if (!expectInput(TRACE_BYTES)) return;
+    bool recordedValid = get8();
+    size_t stored = get16();
+  
+    // Recorded by a build with a different layout
+    if (recordedValid && stored != length) {
+      replayPosition = start;
+      divergeReplay(TRACE_BYTES, TRACE_BYTES);
+      return;
+    }
+  
+    valid = recordedValid;
+    memcpy(data, replayData + replayPosition, stored);
+    replayPosition += stored;
+  }
+}
+
+void traceMotors(int left, int right) {
+  if (left == lastLeftMotor && right == lastRightMotor) return;
+  lastLeftMotor = left;
+  lastRightMotor = right;
+  
+  if (traceMode == TRACE_RECORD) {
+    if (!beginRecord(TRACE_MOTORS, 4, millis())) return;
+    put16(left);
+    put16(right);
+  }
+  else if (traceMode == TRACE_REPLAY) {
+    if (replayEnded()) return;
+    replayStats.motorCommands++;
+    if (peekRecord() != TRACE_MOTORS) {
+      // A command the recorded run did not send
+      replayStats.motorMismatches++;
+      if (stopOnMotorMismatch) divergeReplay(TRACE_MOTORS, peekRecord());
+      return;
+    }
+  
+    consumeHeader();
+    int recordedLeft = (int16_t)get16();
+    int recordedRight = (int16_t)get16();
+    if (recordedLeft != left || recordedRight != right) {
+      replayStats.motorMismatches++;
+      replayStats.motorErrorSum += (double)(recordedLeft - left) * (recordedLeft - left) +
+                                   (double)(recordedRight - right) * (recordedRight - right);
+      if (stopOnMotorMismatch) divergeReplay(TRACE_MOTORS, TRACE_MOTORS);
+    }
+  }
+}
+
+void traceDecision(int x, int y, int direction, int nextDirection) {
+  if (traceMode == TRACE_RECORD) {
+    if (!beginRecord(TRACE_DECISION, 4, millis())) return;
+    put8(x);
+    put8(y);
+    put8(direction);
+    put8((int8_t)nextDirection);
+  }
+  else if (traceMode == TRACE_REPLAY) {
+    if (replayEnded()) return;
+    replayStats.decisions++;
+    bool match = peekRecord() == TRACE_DECISION;
+    if (match) {
+      consumeHeader();
+      match = get8() == x;
+      match = (get8() == y) && match;
+      match = (get8() == direction) && match;
+      match = ((int8_t)get8() == nextDirection) && match;
+    }
+  
+    if (!match) {
+      replayStats.decisionMismatches++;
+      if (stopOnMotorMismatch) divergeReplay(TRACE_DECISION, peekRecord());
+    }
+  }
+}
+
+// Compare the firmware state with the checkpoint at the replay position,
+// or restore it from there. False if the state differs, or the checkpoint
+// was recorded by a build with different state
+static bool replayCheckpoint(bool restore) {
+  size_t start = replayPosition;
+  consumeHeader();
+  replayStats.checkpoints++;
+  int blocks = get8();
+  size_t size = get16();
+  if (blocks != stateBlockCount || size != checkpointSize()) {
+    replayPosition = start;
+    divergeReplay(TRACE_CHECKPOINT, TRACE_CHECKPOINT);
+    return false;
+  }
+  
+  int unchanged = get8();
+  long left = (int32_t)get32();
+  long right = (int32_t)get32();
+  int leftMotor = (int16_t)get16();
+  int rightMotor = (int16_t)get16();
+  bool match = unchanged == unchangedEncoderReads && left == lastLeftCount && right == lastRightCount &&
+               leftMotor == lastLeftMotor && rightMotor == lastRightMotor;
+  if (restore) {
+    unchangedEncoderReads = unchanged;
+    lastLeftCount = left;
+    lastRightCount = right;
+    lastLeftMotor = leftMotor;
+    lastRightMotor = rightMotor;
+  }
+  
+  for (int i = 0; i < stateBlockCount; i++) {
+    const TraceStateBlock& block = stateBlocks[i];
+    if (block.kind == STATE_LONG) {
+      long value = (int32_t)get32();
+      match = match && *(long*)block.data == value;
+      if (restore) *(long*)block.data = value;
+    } else if (block.kind == STATE_UNSIGNED_LONG) {
+      unsigned long value = get32();
+      match = match && *(unsigned long*)block.data == value;
+      if (restore) *(unsigned long*)block.data = value;
+    } else {
+      match = match && memcmp(block.data, replayData + replayPosition, block.size) == 0;
+      if (restore) memcpy(block.data, replayData + replayPosition, block.size);
+      replayPosition += block.size;
+    }
+  }
+  return match;
+}
+
+void traceCheckpoint() {
+  if (traceMode == TRACE_RECORD) {
+    unsigned long now = millis();
+    if (checkpointRecorded && now - lastCheckpointMs < TRACE_CHECKPOINT_INTERVAL_MS) return;
+  
+    size_t size = checkpointSize();
+    if (!beginRecord(TRACE_CHECKPOINT, 3 + size, now)) return;
+    put8(stateBlockCount);
+    put16(size);
+    put8(unchangedEncoderReads);
+    put32(lastLeftCount);
+    put32(lastRightCount);
+    put16(lastLeftMotor);
+    put16(lastRightMotor);
+    for (int i = 0; i < stateBlockCount; i++) {
+      const TraceStateBlock& block = stateBlocks[i];
+      if (block.kind == STATE_LONG) {
+        put32(*(long*)block.data);
+      } else if (block.kind == STATE_UNSIGNED_LONG) {
+        put32(*(unsigned long*)block.data);
+      } else {
+        for (size_t j = 0; j < block.size; j++) {
+          put8(((const uint8_t*)block.data)[j]);
+        }
+      }
+    }
+    checkpointRecorded = true;
+    lastCheckpointMs = now;
+  }
+  else if (traceMode == TRACE_REPLAY_PENDING) {
+    // The replay starts here: the state setup() built is replaced
+    traceMode = TRACE_REPLAY;
+    replayCheckpoint(true);
+  }
+  else if (traceMode == TRACE_REPLAY) {
+    if (replayEnded() || peekRecord() != TRACE_CHECKPOINT) return;
+  
+    size_t start = replayPosition;
+    if (!replayCheckpoint(false) && traceMode == TRACE_REPLAY) {
+      replayStats.checkpointMismatches++;
+      if (stopOnMotorMismatch) {
+        replayPosition = start;
+        divergeReplay(TRACE_CHECKPOINT, TRACE_CHECKPOINT);
+      }
+    }
+  }
+}
+
+// ================== Access ==================
+
+void stopTrace() {
+  traceMode = TRACE_OFF;
+}
+
+TraceMode getTraceMode() {
+  return traceMode;
+}
+
+static void reverseBytes(uint8_t* first, uint8_t* last) {
+  while (first < last) {
+    uint8_t byte = *first;
+    *first++ = *--last;
+    *last = byte;
+  }
+}
+
+// Rotate the ring in place so the oldest record follows the base time
+// record and the records read in order
+static void unwrapRing() {
+  uint8_t* ring = traceBuffer + TRACE_RECORDS_START;
+  size_t start = ringHead % ringSize();
+  if (start != 0) {
+    reverseBytes(ring, ring + start);
+    reverseBytes(ring + start, ring + ringSize());
+    reverseBytes(ring, ring + ringSize());
+  }
+  ringTail -= ringHead;
+  ringHead = 0;
+  traceLength = TRACE_RECORDS_START + ringTail;
+}
+
+const uint8_t* getTraceData(size_t* length) {
+  if (replayData == NULL && traceBuffer != NULL) {
+    unwrapRing();
+  }
+  *length = traceLength;
+  return replayData != NULL ? replayData : traceBuffer;
+}
+
+void setTraceReplayEndCallback(TraceReplayEndCallback callback) {
+  replayEndCallback = callback;
+}
+
+TraceReplayStats getTraceReplayStats() {
+  return replayStats;
+}
+
+void dumpTrace() {
+  size_t length = 0;
+  const uint8_t* data = getTraceData(&length);
+  if (data == NULL) {
+    Serial.println("No trace recorded");
+    return;
+  }
+  
+  static const char hexDigits[] = "0123456789ABCDEF";
+  char line[65];
+  uint16_t sum1 = 0, sum2 = 0;
+  
+  Serial.print("TRACE BEGIN ");
+  Serial.println((unsigned long)length);
+  
+  // 32 bytes per line, with a Fletcher-16 checksum over all of them
+  for (size_t i = 0; i < length; i += 32) {
+    int count = 0;
+    for (size_t j = i; j < length && j < i + 32; j++) {
+      line[count++] = hexDigits[data[j] >> 4];
+      line[count++] = hexDigits[data[j] & 0x0F];
+      sum1 = (sum1 + data[j]) % 255;
+      sum2 = (sum2 + sum1) % 255;
+    }
+    line[count] = 0;
+    Serial.println(line);
+  }
+  
+  Serial.print("TRACE END ");
+  Serial.println((unsigned long)((sum2 << 8) | sum1), HEX);
+}
@@ -0,0 +1,219 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include "Config.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Trace Recorder Module
+ * 
+ * This module records every input the control and navigation code reads
+ * into a compact binary trace, so a run can be replayed exactly on the
+ * host:
+ * - Encoder counts (only reads that see a change are stored)
+ * - ToF readings from readTOF()
+ * - PID clock readings
+ * - The stored maze loaded at startup
+ * - Motor commands and navigation decisions, to check a replay
+ * - Checkpoints of the firmware state, every TRACE_CHECKPOINT_INTERVAL_MS
+ * 
+ * Record mode writes to a RAM buffer that is printed over Serial on
+ * request. When the buffer is full the oldest records are dropped, so it
+ * always holds the end of the run. In replay mode the same hooks feed the
+ * recorded values back instead of the live ones and compare the outputs
+ * with the trace. A trace that lost its start is replayed from the oldest
+ * checkpoint it still holds.
+ * 
+ * Trace layout (little-endian): an 8 byte header ("MTRC", version, flags,
+ * maze rows, maze cols), a TRACE_TIME record holding the time of the
+ * dropped records (0 if none were dropped), then records of one type
+ * byte, a 16-bit millisecond delta from the previous record and a type
+ * specific payload.
+ * 
+ * A checkpoint holds the recorder's own state (u8 unchanged encoder reads,
+ * i32 left and right counts, i16 left and right motor commands) followed
+ * by every TraceState block, sorted by name. Longs are stored in 32 bits
+ * as on the robot; everything else as it lies in memory.
+ */
+
+// Record types
+enum TraceRecordType {
+  TRACE_TIME = 1,         // u32 absolute millis(), when a delta does not fit
+  TRACE_CLOCK = 2,        // A millis() reading; the record time is the value
+  TRACE_ENCODERS = 3,     // u8 unchanged reads before, i16 left delta, i16 right delta
+  TRACE_ENCODERS_ABS = 4, // u8 unchanged reads before, i32 left, i32 right
+  TRACE_TOF = 5,          // u16 left, center, right (mm)
+  TRACE_MOTORS = 6,       // i16 left, right wheel speed setpoint (mm/s)
+  TRACE_DECISION = 7,     // u8 x, y, direction, i8 next direction
+  TRACE_BYTES = 8,        // u8 valid, u16 length, data
+  TRACE_CHECKPOINT = 9    // u8 state blocks, u16 length, recorder state, state blocks
+};
+
+enum TraceMode {
+  TRACE_OFF,
+  TRACE_RECORD,
+  TRACE_REPLAY,
+  TRACE_REPLAY_PENDING  // Live inputs until the checkpoint the replay starts from
+};
+
+const uint8_t TRACE_VERSION = 4;
+const int TRACE_HEADER_SIZE = 8;
+const int TRACE_RECORDS_START = TRACE_HEADER_SIZE + 7; // After the base time record
+const uint8_t TRACE_FLAG_WRAPPED = 0x01;  // The oldest records were dropped
+
+// Replay results
+struct TraceReplayStats {
+  long records;           // Records consumed
+  long motorCommands;     // Motor commands compared
+  long motorMismatches;   // Motor commands that differ from the trace
+  double motorErrorSum;   // Sum of squared motor command differences
+  long decisions;         // Navigation decisions compared
+  long decisionMismatches;
+  long checkpoints;       // Checkpoints compared
+  long checkpointMismatches;
+  long startedAt;         // Byte offset of the checkpoint the replay started from, 0 at setup()
+  unsigned long startMs;  // Trace time of that checkpoint
+  bool finished;          // The firmware read past the end of the trace
+  bool diverged;          // The firmware stopped following the trace
+  long divergedAt;        // Byte offset of the record where it diverged
+  int expectedType;       // Record type the firmware asked for
+  int foundType;          // Record type in the trace
+};
+
+/**
+ * @brief Firmware state saved in trace checkpoints
+ * Define one at file scope next to each global the replayed code keeps
+ * from one loop() to the next. A replay that starts from a checkpoint
+ * restores them; one that started at setup() compares them
+ */
+struct TraceState {
+  TraceState(const char* name, void* data, size_t size);
+  TraceState(const char* name, long* value);          // Stored in 32 bits
+  TraceState(const char* name, unsigned long* value); // Stored in 32 bits
+};
+
+/**
+ * @brief Start recording a trace
+ * Does nothing if a recording or replay is already running, so host tools
+ * can start one before setup()
+ * @param buffer Trace storage, or NULL for the built-in TRACE_BUFFER_SIZE
+ *               buffer (none when TRACE_RECORDING is 0)
+ * @param capacity Size of buffer in bytes
+ */
+void startTraceRecording(uint8_t* buffer = NULL, size_t capacity = 0);
+
+/**
+ * @brief Replay a recorded trace through the firmware
+ * From now on the trace hooks return recorded inputs and check outputs
+ * @param data Trace including the header
+ * @param length Trace length in bytes
+ * @param stopOnMotorMismatch Treat a different motor command as divergence;
+ *                            false keeps replaying to compare controllers
+ * @return true if the header is valid and the trace starts at setup(),
+ *         or still holds a checkpoint if its oldest records were dropped.
+ *         From a checkpoint the hooks pass live values until the next
+ *         traceCheckpoint() call restores it
+ */
+bool startTraceReplay(const uint8_t* data, size_t length, bool stopOnMotorMismatch = true);
+
+/**
+ * @brief Stop recording or replaying
+ */
+void stopTrace();
+
+/**
+ * @brief Get the current trace mode
+ * @return TRACE_OFF, TRACE_RECORD or TRACE_REPLAY
+ */
+TraceMode getTraceMode();
+
+/**
+ * @brief Get the recorded trace
+ * Puts the records in order inside the buffer; recording can go on
+ * @param length Receives the trace length in bytes
+ * @return Trace data including the header, NULL if nothing was recorded
+ */
+const uint8_t* getTraceData(size_t* length);
+
+/**
+ * @brief Get the size of a trace record
+ * @param data Trace including the header
+ * @param length Trace length in bytes
+ * @param position Byte offset of the record
+ * @return Record size in bytes, 0 if it is unknown or cut off
+ */
+size_t traceRecordSize(const uint8_t* data, size_t length, size_t position);
+
+/**
+ * @brief Print the trace over Serial as hex lines
+ * Framed by "TRACE BEGIN <bytes>" and "TRACE END <checksum>" so it can be
+ * cut out of a serial monitor log; recording pauses while printing
+ */
+void dumpTrace();
+
+/**
+ * @brief Called once when a replay ends or diverges
+ * Host tools use it to leave the firmware's loops
+ */
+typedef void (*TraceReplayEndCallback)();
+
+/**
+ * @brief Register the replay end callback
+ * @param callback Function to call, or NULL to just stop replaying
+ */
+void setTraceReplayEndCallback(TraceReplayEndCallback callback);
+
+/**
+ * @brief Get replay results
+ * @return Counters and divergence information
+ */
+TraceReplayStats getTraceReplayStats();
+
+// ================== Hooks ==================
+// Inputs are recorded, or replaced by the recorded values in replay mode.
+// Outputs are recorded, or compared with the trace in replay mode.
+
+/**
+ * @brief Encoder counts read by the firmware (input)
+ */
+void traceEncoders(long& left, long& right);
+
+/**
+ * @brief ToF distances after readTOF() (input)
+ */
+void traceTOF(int& left, int& center, int& right);
+
+/**
+ * @brief millis() reading used by a controller (input)
+ */
+void traceClock(unsigned long& now);
+
+/**
+ * @brief Data read from flash or the serial monitor (input)
+ * @param data Buffer holding the data
+ * @param length Buffer size in bytes
+ * @param valid Whether the read succeeded
+ */
+void traceBytes(void* data, size_t length, bool& valid);
+
+/**
+ * @brief Motor command: the wheel speed setpoints handed to the control
+ * loop (output, stored only when it changes)
+ */
+void traceMotors(int left, int right);
+
+/**
+ * @brief Navigation decision in a cell (output)
+ */
+void traceDecision(int x, int y, int direction, int nextDirection);
+
+/**
+ * @brief Checkpoint of the firmware state, called at the top of loop()
+ * Recorded once TRACE_CHECKPOINT_INTERVAL_MS have passed since the last
+ * one. A replay compares the state with a recorded checkpoint, or
+ * restores it when the replay starts from there
+ */
+void traceCheckpoint();
+
+#endif // TRACE_RECORDER_H
@@ -0,0 +1,107 @@
+#include "VelocityControl.h"
+#include "Encoder.h"
+#include "MotorControl.h"
+#include "Calibration.h"
+#include "TraceRecorder.h"
+#include <Arduino.h>
+
+// Wheel state: target, filtered measurement and PI integral
+struct WheelVelocity {
+  float target;     // mm/s
+  float measured;   // mm/s
+  float integral;   // mm
+  long lastCount;
+};
+
+static WheelVelocity leftWheel = {0, 0, 0, 0};
+static WheelVelocity rightWheel = {0, 0, 0, 0};
+static float targetAcceleration = 0;
+
+#ifdef ESP32
+// Setpoints and wheel state are shared with the control task on the other core
+static portMUX_TYPE velocityLock = portMUX_INITIALIZER_UNLOCKED;
+#define LOCK_VELOCITY_STATE()   portENTER_CRITICAL(&velocityLock)
+#define UNLOCK_VELOCITY_STATE() portEXIT_CRITICAL(&velocityLock)
+#else
+#define LOCK_VELOCITY_STATE()
+#define UNLOCK_VELOCITY_STATE()
+#endif
+
+// Motor command that holds a speed on a level floor, plus the lead the
+// motor needs to follow an acceleration
+static float feedforwardPWM(float velocity) {
+  if (velocity == 0) return 0;
+  float staticPWM = (velocity > 0) ? MOTOR_STATIC_PWM : -MOTOR_STATIC_PWM;
+  return staticPWM + velocity * MOTOR_PWM_PER_MM_S + targetAcceleration * MOTOR_PWM_PER_MM_S2;
+}
+
+static float updateWheel(WheelVelocity& wheel, long count, float dt) {
+  float raw = (count - wheel.lastCount) / getCountsPerMM() / dt;
+  wheel.measured += (raw - wheel.measured) * dt / (dt + VELOCITY_FILTER_S);
+  wheel.lastCount = count;
+  
+  // A stopped wheel stays stopped instead of holding on to the integral
+  if (wheel.target == 0) {
+    wheel.integral = 0;
+    return 0;
+  }
+  
+  float error = wheel.target - wheel.measured;
+  float integralLimit = VELOCITY_INTEGRAL_LIMIT / VELOCITY_KI;
+  wheel.integral = constrain(wheel.integral + error * dt, -integralLimit, integralLimit);
+  
+  float pwm = feedforwardPWM(wheel.target) + VELOCITY_KP * error + VELOCITY_KI * wheel.integral;
+  return constrain(pwm, -MAX_SPEED, MAX_SPEED);
+}
+
+void updateVelocityControl(float dt) {
+  // Raw counts: a move resetting the encoders does not disturb the speed
+  long leftCount, rightCount;
+  getRawEncoderCounts(leftCount, rightCount);
+  
+  LOCK_VELOCITY_STATE();
+  float leftPWM = updateWheel(leftWheel, leftCount, dt);
+  float rightPWM = updateWheel(rightWheel, rightCount, dt);
+  bool stopped = leftWheel.target == 0 && rightWheel.target == 0;
+  UNLOCK_VELOCITY_STATE();
+  
+  // Hold a stopped robot in place rather than letting it roll
+  if (stopped) {
+    stopMotors();
+  } else {
+    setMotors(leftPWM, rightPWM);
+  }
+}
+
+void setWheelVelocities(float left_mm_s, float right_mm_s, float accel_mm_s2) {
+  left_mm_s = constrain(left_mm_s, -MAX_WHEEL_SPEED_MM_S, MAX_WHEEL_SPEED_MM_S);
+  right_mm_s = constrain(right_mm_s, -MAX_WHEEL_SPEED_MM_S, MAX_WHEEL_SPEED_MM_S);
+  traceMotors((int)round(left_mm_s), (int)round(right_mm_s));
+  
+  LOCK_VELOCITY_STATE();
+  leftWheel.target = left_mm_s;
+  rightWheel.target = right_mm_s;
+  targetAcceleration = accel_mm_s2;
+  UNLOCK_VELOCITY_STATE();
+}
+
+void stopVelocityControl() {
+  traceMotors(0, 0);
+  
+  // The next tick turns the motors off
+  LOCK_VELOCITY_STATE();
+  leftWheel.target = 0;
+  rightWheel.target = 0;
+  targetAcceleration = 0;
+  leftWheel.integral = 0;
+  rightWheel.integral = 0;
+  UNLOCK_VELOCITY_STATE();
+}
+
+float getLeftWheelVelocity() {
+  return leftWheel.measured;
+}
+
+float getRightWheelVelocity() {
+  return rightWheel.measured;
+}
@@ -0,0 +1,58 @@
+#ifndef VELOCITY_CONTROL_H
+#define VELOCITY_CONTROL_H
+
+#include "Config.h"
+
+/**
+ * @brief Velocity Control Module
+ * 
+ * This module closes a velocity loop around each wheel so the motion
+ * layer commands wheel speeds in mm/s instead of raw PWM:
+ * - Feedforward from the target speed (MOTOR_STATIC_PWM + MOTOR_PWM_PER_MM_S)
+ *   and acceleration (MOTOR_PWM_PER_MM_S2)
+ * - PI correction from the speed measured with the encoders
+ * - Low-pass filtered speed measurement
+ * 
+ * The loop runs once per updateVelocityControl() call, at a fixed rate
+ * from the control loop (ControlLoop.h); the motion code only sets the
+ * targets.
+ */
+
+/**
+ * @brief Set the wheel speed targets
+ * Taken over by the next control tick; recorded in the trace as the
+ * motion code's output
+ * @param left_mm_s Left wheel speed (negative for reverse)
+ * @param right_mm_s Right wheel speed (negative for reverse)
+ * @param accel_mm_s2 Forward acceleration of both wheels, e.g. from a motion profile
+ */
+void setWheelVelocities(float left_mm_s, float right_mm_s, float accel_mm_s2 = 0);
+
+/**
+ * @brief Run one control update
+ * Measures the wheel speeds since the last update and sets the motors
+ * @param dt Time since the last update (s), the control loop period
+ */
+void updateVelocityControl(float dt);
+
+/**
+ * @brief Stop the motors and clear the controller state
+ * The motors turn off on the next control tick
+ */
+void stopVelocityControl();
+
+/**
+ * @brief Get the measured left wheel speed
+ * Published by the control loop; not recorded in the trace
+ * @return Filtered speed in mm/s
+ */
+float getLeftWheelVelocity();
+
+/**
+ * @brief Get the measured right wheel speed
+ * Published by the control loop; not recorded in the trace
+ * @return Filtered speed in mm/s
+ */
+float getRightWheelVelocity();
+
+#endif // VELOCITY_CONTROL_H
@@ -14,12 +14,39 @@
 #include "Config.h"
 #include "MotorControl.h"
 #include "Encoder.h"
+#include "Calibration.h"
+#include "ControlLoop.h"
 #include "TOFSensors.h"
 #include "Movement.h"
-#include "WallFollowing.h"
 #include "MazeNavigation.h"
+#include "Mission.h"
+#include "TraceRecorder.h"
 #include <Arduino.h>
 
+/**
+ * @brief Wait briefly for the calibration command on the serial monitor
+ * The answer is recorded in the trace, so a replay takes the same path
+ * @return true if a calibration run was requested
+ */
+bool calibrationRequested() {
+  Serial.print("Send '");
+  Serial.print(CALIBRATION_COMMAND);
+  Serial.println("' to calibrate");
+  
+  char command = 0;
+  bool requested = false;
+  unsigned long start = millis();
+  while (!requested && millis() - start < CALIBRATION_PROMPT_MS) {
+    if (Serial.available()) {
+      command = Serial.read();
+      requested = command == CALIBRATION_COMMAND;
+    }
+    delay(10);
+  }
+  traceBytes(&command, sizeof(command), requested);
+  return requested;
+}
+
 /**
  * @brief Arduino setup function
  * Initializes all robot subsystems
@@ -27,6 +54,9 @@
 void setup() {
   Serial.begin(115200);
   
+  // Record every sensor and encoder reading for replay on the host
+  startTraceRecording();
+  
   // Initialize LED
   pinMode(LED_BUILTIN, OUTPUT);
   digitalWrite(LED_BUILTIN, LOW);
@@ -39,29 +69,54 @@ void setup() {
   initMotors();
   initEncoders();
   
+  // Effective wheel diameter and wheel base, before anything drives
+  initCalibration();
+  
+  // Wheel speed control runs at a fixed rate from here on
+  startControlLoop();
+  
   // Initialize TOF sensors
   if (!initTOFSensors()) {
     Serial.println("Failed to initialize TOF sensors!");
     while (1); // Stop execution if sensors fail
   }
   
-  // Initialize wall following and maze navigation
-  initWallFollowing();
+  // The calibration run starts and ends in the start cell, before the
+  // navigation places the pose there
+  if (calibrationRequested()) {
+    runCalibration();
+  }
+  
   initMazeNavigation();
+  initMission();
   
   Serial.println("Robot Ready!");
-  Serial.print("COUNTS_PER_MM: ");
-  Serial.println(COUNTS_PER_MM);
-  Serial.print("COUNTS_PER_90_DEG: ");
-  Serial.println(COUNTS_PER_90_DEG);
+  Serial.print("Counts per mm: ");
+  Serial.println(getCountsPerMM());
+  Serial.print("Battery: ");
+  Serial.print(getBatteryVoltage(), 2);
+  Serial.println("V");
 }
 
 /**
  * @brief Arduino main loop function
- * Runs the main maze solving algorithm
+ * Runs the explore / return / speed run mission
  */
 void loop() {
+  // A trace that loses its start replays from the last of these
+  traceCheckpoint();
+  
   // Main maze solving loop
-  decideAndMove();
-  delay(100);
+  runMission();
+  
+  // Print the run trace on request from the serial monitor
+  if (Serial.available() && Serial.read() == TRACE_DUMP_COMMAND) {
+    dumpTrace();
+  }
+  
+  // Streaming search must not pause between cells, nor a route between
+  // its primitives
+  if (!streamingSearch && !isDrivingRoute()) {
+    delay(100);
+  }
 }
@@ -0,0 +1,138 @@
+/**
+ * @file bench_flood.cpp
+ * @brief Host microbenchmark: wavefront flood fill vs. queue-based BFS
+ * 
+ * Runs the templated floodFillWavefront() and the previous queue-based
+ * updateFlood() BFS on the same random mazes, checks that both produce
+ * identical distances and prints the average time per flood. Both the
+ * 16x16 classic and the 32x32 half-size maze are measured.
+ * 
+ * Build and run on the host (from this directory):
+ *   g++ -O2 -std=gnu++11 -I.. bench_flood.cpp ../FloodFill.cpp -o bench_flood
+ *   ./bench_flood [mazes] [iterations]
+ */
+
+#include "FloodFill.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Queue-based BFS as previously used by updateFlood()
+template <int ROWS, int COLS>
+static void floodFillQueue(const MazeWalls<ROWS, COLS>& map, int goalX, int goalY,
+                           typename MazeGeometry<ROWS, COLS>::Distance flood[ROWS][COLS]) {
+  for(int r = 0; r < ROWS; r++) {
+    for(int c = 0; c < COLS; c++) {
+      flood[r][c] = MazeGeometry<ROWS, COLS>::UNREACHABLE;
+    }
+  }
+  flood[goalY][goalX] = 0;
+  
+  int queueX[ROWS * COLS];
+  int queueY[ROWS * COLS];
+  int front = 0, rear = 0;
+  queueX[rear] = goalX;
+  queueY[rear] = goalY;
+  rear++;
+  
+  while(front < rear) {
+    int currX = queueX[front];
+    int currY = queueY[front];
+    front++;
+    int currentDistance = flood[currY][currX];
+    
+    for(int d = 0; d < 4; d++) {
+      int newX = currX + DIR_DX[d];
+      int newY = currY + DIR_DY[d];
+      if(newX >= 0 && newX < COLS && newY >= 0 && newY < ROWS) {
+        if(!((map.wallMask(currX, currY) >> d) & 1)) {
+          int newDistance = currentDistance + 1;
+          if(newDistance < flood[newY][newX]) {
+            flood[newY][newX] = newDistance;
+            queueX[rear] = newX;
+            queueY[rear] = newY;
+            rear++;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Random interior walls with the outer boundary closed
+template <int ROWS, int COLS>
+static void randomMaze(MazeWalls<ROWS, COLS>& map, int wallPercent) {
+  memset(&map, 0, sizeof(map));
+  for(int i = 0; i <= ROWS; i++) {
+    for(int x = 0; x < COLS; x++) {
+      bool boundary = (i == 0 || i == ROWS);
+      if(boundary || rand() % 100 < wallPercent) map.hWalls[i] |= 1UL << x;
+    }
+  }
+  for(int i = 0; i <= COLS; i++) {
+    for(int y = 0; y < ROWS; y++) {
+      bool boundary = (i == 0 || i == COLS);
+      if(boundary || rand() % 100 < wallPercent) map.vWalls[i] |= 1UL << y;
+    }
+  }
+}
+
+template <typename F>
+static double timePerCall(int iterations, F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < iterations; i++) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+// Compare both floods on random ROWS x COLS mazes, returns mismatches
+template <int ROWS, int COLS>
+static int runBench(int mazes, int iterations) {
+  typedef MazeGeometry<ROWS, COLS> Geometry;
+  const int goalX = COLS / 2;
+  const int goalY = ROWS / 2;
+  
+  static typename Geometry::Distance floodQueue[ROWS][COLS];
+  static typename Geometry::Distance floodWave[ROWS][COLS];
+  typename Geometry::Row goalRows[ROWS] = {0};
+  goalRows[goalY] = (typename Geometry::Row)1 << goalX;
+  
+  srand(1);
+  double queueTotal = 0, waveTotal = 0;
+  int mismatches = 0;
+  
+  for(int m = 0; m < mazes; m++) {
+    MazeWalls<ROWS, COLS> map;
+    randomMaze(map, 10 + (m % 4) * 10);
+    
+    floodFillQueue(map, goalX, goalY, floodQueue);
+    floodFillWavefront(map, goalRows, floodWave);
+    if(memcmp(floodQueue, floodWave, sizeof(floodQueue)) != 0) {
+      mismatches++;
+    }
+    
+    queueTotal += timePerCall(iterations, [&]() { floodFillQueue(map, goalX, goalY, floodQueue); });
+    waveTotal += timePerCall(iterations, [&]() { floodFillWavefront(map, goalRows, floodWave); });
+  }
+  
+  printf("%dx%d maze (%d-byte wall map, %d-byte flood)\n", COLS, ROWS,
+         (int)sizeof(MazeWalls<ROWS, COLS>), (int)sizeof(floodWave));
+  printf("  queue BFS:  %8.3f us/flood\n", queueTotal / mazes);
+  printf("  wavefront:  %8.3f us/flood\n", waveTotal / mazes);
+  printf("  speedup:    %8.2fx\n", queueTotal / waveTotal);
+  printf("  mismatches: %d\n", mismatches);
+  return mismatches;
+}
+
+int main(int argc, char** argv) {
+  int mazes = (argc > 1) ? atoi(argv[1]) : 100;
+  int iterations = (argc > 2) ? atoi(argv[2]) : 2000;
+  
+  printf("mazes: %d, iterations per maze: %d\n", mazes, iterations);
+  int mismatches = runBench<16, 16>(mazes, iterations);
+  mismatches += runBench<32, 32>(mazes, iterations / 4);
+  return mismatches ? 1 : 0;
+}
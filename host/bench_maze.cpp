@@ -0,0 +1,247 @@
+/**
+ * @file bench_maze.cpp
+ * @brief Host benchmark: flood fill exploration on a corpus of maze files
+ *
+ * Runs the firmware's MazeNavigation decision logic (updateFlood() and
+ * getNextDirection()) cell by cell with an ideal wall oracle: on every
+ * cell the front, left and right walls are taken from the real maze, the
+ * same three walls scanWalls() would read. Each maze is searched like the
+ * mission does it: to the goal, then back towards the start until the
+ * best path is proven (or the start is reached).
+ *
+ * Reported per maze: cells explored, steps, turns, decisions per second,
+ * flood and decision time per step, and the learned speed run against the
+ * one planned on the fully known maze. Results can be written as JSON or
+ * CSV to compare algorithm changes run over run.
+ *
+ * Build and run on the host (from this directory):
+ *   make bench_maze
+ *   ./bench_maze [--json out.json] [--csv out.csv] mazes/sample_16x16.txt ...
+ */
+
+#include "SimHardware.h"
+#include "SimMaze.h"
+#include "MazeNavigation.h"
+#include "FloodFill.h"
+#include "PathPlanner.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Give up on mazes the search cannot finish
+const int MAX_SEARCH_STEPS = 20 * MAZE_ROWS * MAZE_COLS;
+
+struct MazeResult {
+  std::string maze;
+  bool reachedGoal;
+  bool explorationComplete;
+  int searchSteps;      // Start to goal
+  int returnSteps;      // Goal back towards the start
+  int cellsExplored;
+  int turns;            // In 90° units, a turn-around counts twice
+  int decisions;
+  double floodUs;       // Per decision
+  double decideUs;      // Per decision
+  double decisionsPerSecond;
+  int shortestPath;     // True shortest start-goal path in cells
+  int learnedPath;      // Speed run route on the learned map, in cells
+  unsigned long idealRunMs;   // Speed run planned on the fully known maze
+  unsigned long learnedRunMs; // Speed run planned on the learned map
+};
+
+// Walls the robot sees standing in the current cell (front, right, left)
+static void oracleScan(const SimMaze& maze) {
+  int sides[3] = {dir, (dir + 1) % 4, (dir + 3) % 4};
+  for (int i = 0; i < 3; i++) {
+    setWall(currentX, currentY, sides[i], maze.hasWall(currentX, currentY, sides[i]));
+  }
+}
+
+// One decideAndMove() without the motion
+static bool step(const SimMaze& maze, MazeResult& result) {
+  typedef std::chrono::steady_clock Clock;
+
+  Clock::time_point t0 = Clock::now();
+  oracleScan(maze);
+  updateFlood(currentX, currentY);
+  Clock::time_point t1 = Clock::now();
+  markCurrentCellVisited();
+  int nextDir = getNextDirection();
+  Clock::time_point t2 = Clock::now();
+
+  result.floodUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+  result.decideUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+  result.decisions++;
+
+  if (nextDir < 0) {
+    return false;
+  }
+
+  int turnDiff = (nextDir - dir + 4) % 4;
+  result.turns += (turnDiff == 2) ? 2 : (turnDiff != 0);
+  dir = nextDir;
+  updatePosition(dir);
+  return true;
+}
+
+static WallMap trueWallMap(const SimMaze& maze) {
+  WallMap map;
+  memset(&map, 0, sizeof(map));
+  for (int y = 0; y <= MAZE_ROWS; y++) {
+    for (int x = 0; x < MAZE_COLS; x++) {
+      bool wall = (y < MAZE_ROWS) ? maze.hasWall(x, y, 2) : maze.hasWall(x, y - 1, 0);
+      if (wall) map.hWalls[y] |= (MazeRow)1 << x;
+      map.hKnown[y] |= (MazeRow)1 << x;
+    }
+  }
+  for (int x = 0; x <= MAZE_COLS; x++) {
+    for (int y = 0; y < MAZE_ROWS; y++) {
+      bool wall = (x < MAZE_COLS) ? maze.hasWall(x, y, 3) : maze.hasWall(x - 1, y, 1);
+      if (wall) map.vWalls[x] |= (Maze::Column)1 << y;
+      map.vKnown[x] |= (Maze::Column)1 << y;
+    }
+  }
+  return map;
+}
+
+static MazeResult runMaze(const SimMaze& maze) {
+  MazeResult result = MazeResult();
+  result.maze = maze.name;
+
+  simInit(maze, defaultSimConfig());
+  setNavigationTarget(TARGET_GOAL);
+  initMazeNavigation();
+
+  // Search to the goal
+  while (!isTargetCell(currentX, currentY) && result.searchSteps < MAX_SEARCH_STEPS) {
+    if (!step(maze, result)) break;
+    result.searchSteps++;
+  }
+  result.reachedGoal = isTargetCell(currentX, currentY);
+
+  // Search back until nothing unexplored can shorten the path
+  if (result.reachedGoal) {
+    oracleScan(maze);
+    markCurrentCellVisited();
+    setNavigationTarget(TARGET_START);
+    while (!isTargetCell(currentX, currentY) && result.returnSteps < MAX_SEARCH_STEPS) {
+      if (updateExplorationStatus()) break;
+      if (!step(maze, result)) break;
+      result.returnSteps++;
+    }
+    result.explorationComplete = updateExplorationStatus();
+  }
+
+  for (int y = 0; y < MAZE_ROWS; y++) {
+    for (int x = 0; x < MAZE_COLS; x++) {
+      result.cellsExplored += visited[y][x];
+    }
+  }
+
+  // Compare speed runs from the start on the learned and the true map
+  static uint8_t route[MAZE_ROWS * MAZE_COLS];
+  MazeRow goalRows[MAZE_ROWS];
+  getGoalRows(goalRows);
+  WallMap truth = trueWallMap(maze);
+
+  FloodDistance trueFlood[MAZE_ROWS][MAZE_COLS];
+  floodFillWavefront(truth, goalRows, trueFlood);
+  result.shortestPath = trueFlood[startY][startX];
+
+  planFastestRoute(truth, goalRows, startX, startY, 0, true,
+                   route, MAZE_ROWS * MAZE_COLS, &result.idealRunMs);
+  result.learnedPath = planFastestRoute(wallMap, goalRows, startX, startY, 0, true,
+                                        route, MAZE_ROWS * MAZE_COLS, &result.learnedRunMs);
+
+  double totalUs = result.floodUs + result.decideUs;
+  if (result.decisions > 0) {
+    result.decisionsPerSecond = totalUs > 0 ? result.decisions / (totalUs / 1e6) : 0;
+    result.floodUs /= result.decisions;
+    result.decideUs /= result.decisions;
+  }
+  return result;
+}
+
+static void writeJson(const char* path, const std::vector<MazeResult>& results) {
+  FILE* f = fopen(path, "w");
+  if (!f) { fprintf(stderr, "cannot write %s\n", path); return; }
+
+  fprintf(f, "{\n  \"maze_rows\": %d,\n  \"maze_cols\": %d,\n  \"results\": [\n", MAZE_ROWS, MAZE_COLS);
+  for (size_t i = 0; i < results.size(); i++) {
+    const MazeResult& r = results[i];
+    fprintf(f,
+            "    {\"maze\": \"%s\", \"reached_goal\": %s, \"exploration_complete\": %s, "
+            "\"search_steps\": %d, \"return_steps\": %d, \"cells_explored\": %d, \"turns\": %d, "
+            "\"decisions\": %d, \"flood_us\": %.3f, \"decide_us\": %.3f, \"decisions_per_s\": %.0f, "
+            "\"shortest_path\": %d, \"learned_path\": %d, \"ideal_run_ms\": %lu, \"learned_run_ms\": %lu}%s\n",
+            r.maze.c_str(), r.reachedGoal ? "true" : "false", r.explorationComplete ? "true" : "false",
+            r.searchSteps, r.returnSteps, r.cellsExplored, r.turns,
+            r.decisions, r.floodUs, r.decideUs, r.decisionsPerSecond,
+            r.shortestPath, r.learnedPath, r.idealRunMs, r.learnedRunMs,
+            (i + 1 < results.size()) ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+}
+
+static void writeCsv(const char* path, const std::vector<MazeResult>& results) {
+  FILE* f = fopen(path, "w");
+  if (!f) { fprintf(stderr, "cannot write %s\n", path); return; }
+
+  fprintf(f, "maze,reached_goal,exploration_complete,search_steps,return_steps,cells_explored,turns,"
+             "decisions,flood_us,decide_us,decisions_per_s,shortest_path,learned_path,ideal_run_ms,learned_run_ms\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const MazeResult& r = results[i];
+    fprintf(f, "%s,%d,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.0f,%d,%d,%lu,%lu\n",
+            r.maze.c_str(), r.reachedGoal, r.explorationComplete, r.searchSteps, r.returnSteps,
+            r.cellsExplored, r.turns, r.decisions, r.floodUs, r.decideUs, r.decisionsPerSecond,
+            r.shortestPath, r.learnedPath, r.idealRunMs, r.learnedRunMs);
+  }
+  fclose(f);
+}
+
+int main(int argc, char** argv) {
+  const char* jsonPath = NULL;
+  const char* csvPath = NULL;
+  std::vector<MazeResult> results;
+  int failures = 0;
+
+  printf("%-22s %6s %6s %6s %6s %8s %8s %10s %6s %6s %8s\n", "maze", "search", "return",
+         "cells", "turns", "flood_us", "decide_us", "decisions/s", "best", "found", "run");
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--json") && i + 1 < argc) { jsonPath = argv[++i]; continue; }
+    if (!strcmp(argv[i], "--csv") && i + 1 < argc) { csvPath = argv[++i]; continue; }
+
+    SimMaze maze;
+    std::string error;
+    if (!loadSimMaze(argv[i], maze, &error)) {
+      fprintf(stderr, "%s: %s\n", argv[i], error.c_str());
+      failures++;
+      continue;
+    }
+    if (maze.rows != MAZE_ROWS || maze.cols != MAZE_COLS) {
+      fprintf(stderr, "%s: maze is %dx%d, firmware is built for %dx%d - skipped\n",
+              argv[i], maze.cols, maze.rows, MAZE_COLS, MAZE_ROWS);
+      continue;
+    }
+
+    MazeResult r = runMaze(maze);
+    results.push_back(r);
+    if (!r.reachedGoal) failures++;
+
+    // Learned speed run time relative to the run on the fully known maze
+    double runRatio = r.idealRunMs ? (double)r.learnedRunMs / r.idealRunMs : 0;
+    printf("%-22s %6d %6d %6d %6d %8.2f %8.2f %10.0f %6d %6d %7.2fx%s\n", r.maze.c_str(),
+           r.searchSteps, r.returnSteps, r.cellsExplored, r.turns, r.floodUs, r.decideUs,
+           r.decisionsPerSecond, r.shortestPath, r.learnedPath, runRatio,
+           r.reachedGoal ? "" : "  (goal not reached)");
+  }
+
+  if (jsonPath) writeJson(jsonPath, results);
+  if (csvPath) writeCsv(csvPath, results);
+  return failures ? 1 : 0;
+}
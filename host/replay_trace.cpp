@@ -0,0 +1,307 @@
+/**
+ * @file replay_trace.cpp
+ * @brief Replay a recorded run trace through the firmware on the host
+ *
+ * Runs the sketch's setup() and loop() with the trace recorder in replay
+ * mode: every encoder read, ToF reading, PID clock reading and stored maze
+ * load returns the recorded value, so the movement, odometry and navigation
+ * logic see exactly what they saw on the robot. Motor commands and cell
+ * decisions are compared with the trace; by default the replay stops at
+ * the first difference.
+ *
+ * With --compare the replay keeps going after motor command differences,
+ * which measures how far a changed controller departs from the recorded
+ * run on the same sensor data.
+ *
+ * The trace is either a binary file (mouse_sim --trace) or a serial
+ * monitor log holding the TRACE BEGIN / TRACE END block printed by
+ * dumpTrace().
+ *
+ * A trace whose oldest records were dropped no longer starts at setup().
+ * It is replayed from the oldest state checkpoint it still holds: setup()
+ * runs on the simulated hardware, and the checkpoint then replaces the
+ * state it built. A trace without a checkpoint is listed instead, as with
+ * --list.
+ *
+ * Usage: replay_trace [-v] [--compare] [--list] trace-file
+ */
+
+#include "SimHardware.h"
+#include "SimMaze.h"
+#include "TraceRecorder.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The sketch (duck.ino)
+void setup();
+void loop();
+
+// Thrown by the replay end callback to leave the firmware's loops
+struct ReplayEnd {};
+
+static void onReplayEnd() {
+  throw ReplayEnd();
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: replay_trace [options] trace-file\n"
+          "  -v          echo the firmware's Serial output\n"
+          "  --compare   keep replaying after motor command differences\n"
+          "  --list      print the records instead of replaying them\n");
+}
+
+static const char* recordTypeName(int type) {
+  switch (type) {
+    case 0:                  return "end of trace / any input";
+    case TRACE_CLOCK:        return "clock";
+    case TRACE_ENCODERS:
+    case TRACE_ENCODERS_ABS: return "encoders";
+    case TRACE_TOF:          return "ToF";
+    case TRACE_MOTORS:       return "motors";
+    case TRACE_DECISION:     return "decision";
+    case TRACE_BYTES:        return "stored data";
+    case TRACE_CHECKPOINT:   return "checkpoint";
+    default:                 return "unknown";
+  }
+}
+
+static uint32_t readLittleEndian(const uint8_t* data, int bytes) {
+  uint32_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | data[i];
+  return value;
+}
+
+// One line per record with its time and values; encoder records after
+// dropped records only show the change in counts
+static void listTrace(const std::vector<uint8_t>& trace) {
+  unsigned long clock = 0;
+  size_t position = TRACE_HEADER_SIZE;
+  size_t size;
+  while ((size = traceRecordSize(trace.data(), trace.size(), position)) != 0) {
+    const uint8_t* record = &trace[position];
+    const uint8_t* payload = record + 3;
+    position += size;
+    clock += readLittleEndian(record + 1, 2);
+
+    switch (record[0]) {
+      case TRACE_TIME:
+        clock = readLittleEndian(payload, 4);
+        continue;
+      case TRACE_CLOCK:
+        printf("%9.3f clock\n", clock / 1000.0);
+        break;
+      case TRACE_ENCODERS:
+        printf("%9.3f encoders %+d %+d after %d unchanged reads\n", clock / 1000.0,
+               (int16_t)readLittleEndian(payload + 1, 2), (int16_t)readLittleEndian(payload + 3, 2),
+               payload[0]);
+        break;
+      case TRACE_ENCODERS_ABS:
+        printf("%9.3f encoders %d %d after %d unchanged reads\n", clock / 1000.0,
+               (int32_t)readLittleEndian(payload + 1, 4), (int32_t)readLittleEndian(payload + 5, 4),
+               payload[0]);
+        break;
+      case TRACE_TOF:
+        printf("%9.3f ToF %u %u %u\n", clock / 1000.0, (unsigned)readLittleEndian(payload, 2),
+               (unsigned)readLittleEndian(payload + 2, 2), (unsigned)readLittleEndian(payload + 4, 2));
+        break;
+      case TRACE_MOTORS:
+        printf("%9.3f motors %d %d\n", clock / 1000.0,
+               (int16_t)readLittleEndian(payload, 2), (int16_t)readLittleEndian(payload + 2, 2));
+        break;
+      case TRACE_DECISION:
+        printf("%9.3f decision at %d,%d heading %d next %d\n", clock / 1000.0,
+               payload[0], payload[1], payload[2], (int8_t)payload[3]);
+        break;
+      case TRACE_BYTES:
+        printf("%9.3f stored data %s, %u bytes\n", clock / 1000.0, payload[0] ? "valid" : "invalid",
+               (unsigned)readLittleEndian(payload + 1, 2));
+        break;
+      case TRACE_CHECKPOINT:
+        printf("%9.3f checkpoint, %u state blocks in %u bytes\n", clock / 1000.0, payload[0],
+               (unsigned)readLittleEndian(payload + 1, 2));
+        break;
+    }
+  }
+  if (position != trace.size()) {
+    printf("unreadable record at byte %zu\n", position);
+  }
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Cut the dumpTrace() block out of a serial log
+static bool parseTraceDump(const std::string& text, std::vector<uint8_t>& trace, std::string* error) {
+  size_t begin = text.rfind("TRACE BEGIN ");
+  if (begin == std::string::npos) {
+    *error = "no trace in file";
+    return false;
+  }
+
+  std::istringstream lines(text.substr(begin));
+  std::string line;
+  std::getline(lines, line);
+  unsigned long length = strtoul(line.c_str() + 12, NULL, 10);
+
+  trace.clear();
+  unsigned int sum1 = 0, sum2 = 0;
+  while (std::getline(lines, line)) {
+    if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+
+    if (line.compare(0, 10, "TRACE END ") == 0) {
+      unsigned long checksum = strtoul(line.c_str() + 10, NULL, 16);
+      if (trace.size() != length) {
+        *error = "trace is cut off";
+        return false;
+      }
+      if (checksum != ((sum2 << 8) | sum1)) {
+        *error = "trace checksum mismatch";
+        return false;
+      }
+      return true;
+    }
+
+    for (size_t i = 0; i + 1 < line.size(); i += 2) {
+      int high = hexValue(line[i]);
+      int low = hexValue(line[i + 1]);
+      if (high < 0 || low < 0) {
+        *error = "unexpected text inside the trace";
+        return false;
+      }
+      uint8_t byte = (high << 4) | low;
+      trace.push_back(byte);
+      sum1 = (sum1 + byte) % 255;
+      sum2 = (sum2 + sum1) % 255;
+    }
+  }
+
+  *error = "missing TRACE END";
+  return false;
+}
+
+static bool loadTrace(const char* path, std::vector<uint8_t>& trace, std::string* error) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    *error = "cannot open file";
+    return false;
+  }
+  std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  if (contents.compare(0, 4, "MTRC") == 0) {
+    trace.assign(contents.begin(), contents.end());
+    return true;
+  }
+  return parseTraceDump(contents, trace, error);
+}
+
+// Outer walls only: replayed inputs do not depend on the simulated maze
+static SimMaze emptyMaze() {
+  SimMaze maze;
+  maze.rows = MAZE_ROWS;
+  maze.cols = MAZE_COLS;
+  maze.name = "replay";
+  maze.walls.assign(MAZE_ROWS * MAZE_COLS, 0);
+  for (int y = 0; y < MAZE_ROWS; y++) {
+    for (int x = 0; x < MAZE_COLS; x++) {
+      uint8_t& cell = maze.walls[y * MAZE_COLS + x];
+      if (y == MAZE_ROWS - 1) cell |= 1;
+      if (x == MAZE_COLS - 1) cell |= 2;
+      if (y == 0) cell |= 4;
+      if (x == 0) cell |= 8;
+    }
+  }
+  return maze;
+}
+
+int main(int argc, char** argv) {
+  SimConfig config = defaultSimConfig();
+  bool compare = false;
+  bool list = false;
+  const char* tracePath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-v")) config.serialOutput = true;
+    else if (!strcmp(argv[i], "--compare")) compare = true;
+    else if (!strcmp(argv[i], "--list")) list = true;
+    else if (argv[i][0] != '-' && !tracePath) tracePath = argv[i];
+    else { usage(); return 2; }
+  }
+  if (!tracePath) { usage(); return 2; }
+
+  std::vector<uint8_t> trace;
+  std::string error;
+  if (!loadTrace(tracePath, trace, &error)) {
+    fprintf(stderr, "%s: %s\n", tracePath, error.c_str());
+    return 2;
+  }
+
+  if (list) {
+    listTrace(trace);
+    return 0;
+  }
+
+  SimMaze maze = emptyMaze();
+  simInit(maze, config);
+
+  setTraceReplayEndCallback(onReplayEnd);
+  if (!startTraceReplay(trace.data(), trace.size(), !compare)) {
+    bool wrapped = trace.size() > 5 && (trace[5] & TRACE_FLAG_WRAPPED);
+    if (wrapped && trace[4] == TRACE_VERSION) {
+      listTrace(trace);
+      printf("%s: the oldest records were dropped and no checkpoint is left, so the trace cannot be replayed\n",
+             tracePath);
+      return 0;
+    }
+    fprintf(stderr, "%s: not a trace for a %dx%d build\n", tracePath, MAZE_COLS, MAZE_ROWS);
+    return 2;
+  }
+
+  try {
+    setup();
+    while (true) {
+      loop();
+    }
+  } catch (const ReplayEnd&) {
+  }
+
+  TraceReplayStats stats = getTraceReplayStats();
+  printf("trace:           %s (%zu bytes)\n", tracePath, trace.size());
+  if (stats.startedAt > 0) {
+    printf("start:           checkpoint at %.3f s (byte %ld)\n", stats.startMs / 1000.0, stats.startedAt);
+  } else {
+    printf("start:           setup()\n");
+  }
+  printf("records:         %ld\n", stats.records);
+  printf("decisions:       %ld (%ld different)\n", stats.decisions, stats.decisionMismatches);
+  printf("checkpoints:     %ld (%ld different)\n", stats.checkpoints, stats.checkpointMismatches);
+  printf("motor commands:  %ld (%ld different", stats.motorCommands, stats.motorMismatches);
+  if (stats.motorMismatches > 0) {
+    printf(", RMS difference %.1f", sqrt(stats.motorErrorSum / stats.motorMismatches));
+  }
+  printf(")\n");
+
+  if (stats.diverged && stats.expectedType == stats.foundType) {
+    printf("result:          diverged at byte %ld: firmware produced a different %s record\n",
+           stats.divergedAt, recordTypeName(stats.foundType));
+    return 1;
+  }
+  if (stats.diverged) {
+    printf("result:          diverged at byte %ld: firmware wanted %s, trace has %s\n",
+           stats.divergedAt, recordTypeName(stats.expectedType), recordTypeName(stats.foundType));
+    return 1;
+  }
+  printf("result:          %s\n", stats.motorMismatches || stats.decisionMismatches || stats.checkpointMismatches ?
+         "replayed to the end with differences" : "replayed to the end, identical");
+  return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef SIM_ADAFRUIT_VL53L0X_H
+#define SIM_ADAFRUIT_VL53L0X_H
+
+/**
+ * @brief VL53L0X driver shim for the host simulator
+ *
+ * Each sensor is identified by the I2C address it was started with
+ * (ADDR_LEFT / ADDR_CENTER / ADDR_RIGHT); rangingTest() ray-casts that
+ * sensor's beam against the loaded maze and takes one timing budget of
+ * simulated time.
+ */
+
+#include <stdint.h>
+#include "Wire.h"
+
+struct VL53L0X_RangingMeasurementData_t {
+  uint16_t RangeMilliMeter;
+  uint8_t RangeStatus; // 4 = out of range (phase failure)
+};
+
+class Adafruit_VL53L0X {
+public:
+  Adafruit_VL53L0X() : address(0) {}
+
+  bool begin(uint8_t i2cAddress = 0x29, TwoWire* wire = &Wire) {
+    address = i2cAddress;
+    return true;
+  }
+
+  void rangingTest(VL53L0X_RangingMeasurementData_t* measure, bool debug = false);
+
+private:
+  uint8_t address;
+};
+
+#endif // SIM_ADAFRUIT_VL53L0X_H
@@ -0,0 +1,121 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+/**
+ * @brief Arduino core shim for the host simulator
+ *
+ * Declares the subset of the ESP32 Arduino core the firmware uses. Time,
+ * pins, PWM and interrupts are implemented by the simulated hardware in
+ * SimHardware.cpp; Serial output goes to stdout when enabled.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#define IRAM_ATTR
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define radians(deg) ((deg) * PI / 180.0)
+#define degrees(rad) ((rad) * 180.0 / PI)
+
+using std::abs;
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Integer mapping, exactly like the Arduino core
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// ================== Time ==================
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// ================== Pins ==================
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+int analogRead(uint8_t pin);
+uint32_t analogReadMilliVolts(uint8_t pin);
+
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+// ================== Serial ==================
+void simSerialWrite(const char* text);
+
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  void flush() {}
+  int available() { return 0; }
+  int read() { return -1; }
+
+  void print(const char* s) { simSerialWrite(s); }
+  void print(char c) { char s[2] = {c, 0}; simSerialWrite(s); }
+  void print(unsigned char n, int base = DEC) { print((unsigned long)n, base); }
+  void print(int n, int base = DEC) { print((long)n, base); }
+  void print(unsigned int n, int base = DEC) { print((unsigned long)n, base); }
+  void print(long n, int base = DEC) {
+    if (base == DEC) format("%ld", n);
+    else if (n < 0) { print('-'); print((unsigned long)-n, base); }
+    else print((unsigned long)n, base);
+  }
+  void print(unsigned long n, int base = DEC) {
+    if (base == HEX) { format("%lX", n); return; }
+    if (base != BIN) { format("%lu", n); return; }
+    char bits[sizeof(n) * 8 + 1];
+    int i = sizeof(bits) - 1;
+    bits[i] = 0;
+    do { bits[--i] = '0' + (n & 1); n >>= 1; } while (n);
+    simSerialWrite(bits + i);
+  }
+  void print(double n, int digits = 2) { format("%.*f", digits, n); }
+
+  template <typename T> void println(T value) { print(value); println(); }
+  template <typename T> void println(T value, int format) { print(value, format); println(); }
+  void println() { simSerialWrite("\r\n"); }
+
+private:
+  template <typename... Args>
+  void format(const char* fmt, Args... args) {
+    char text[64];
+    snprintf(text, sizeof(text), fmt, args...);
+    simSerialWrite(text);
+  }
+};
+
+extern HardwareSerial Serial;
+
+#endif // SIM_ARDUINO_H
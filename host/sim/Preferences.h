@@ -0,0 +1,37 @@
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+/**
+ * @brief NVS Preferences shim for the host simulator
+ * Values live in memory for the lifetime of the process, so a stored maze
+ * survives a simulated reset (setup() called again) like it would in flash
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buffer, size_t length);
+  size_t putBytes(const char* key, const void* value, size_t length);
+
+  float getFloat(const char* key, float defaultValue = 0);
+  size_t putFloat(const char* key, float value);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  size_t putUInt(const char* key, uint32_t value);
+
+private:
+  std::string space;
+  bool readOnly = false;
+};
+
+#endif // SIM_PREFERENCES_H
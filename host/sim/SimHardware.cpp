@@ -0,0 +1,459 @@
+#include "SimHardware.h"
+#include "Config.h"
+#include "ControlLoop.h"
+#include "TraceRecorder.h"
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_VL53L0X.h>
+#include <Preferences.h>
+#include <map>
+#include <random>
+#include <vector>
+
+// Physics runs in fixed steps behind the simulated clock
+const unsigned long PHYSICS_STEP_US = 250;
+const int NUM_PINS = 64;
+const float TOF_MAX_RANGE_MM = 2000;
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+// Axis-aligned wall block
+struct WallBox {
+  float x0, y0, x1, y1;
+};
+
+struct Wheel {
+  int pin1;
+  int pin2;
+  int pinA;
+  int pinB;
+  float speed;   // Wheel surface speed, mm/s
+  double travel; // Wheel surface travel, mm - a float rounds off the 1 kHz steps after some meters
+  long counts;  // Quadrature edges emitted
+};
+
+static SimConfig config;
+static const SimMaze* maze = NULL;
+static std::vector<WallBox> wallBoxes;
+
+static unsigned long long nowUs = 0;
+static unsigned long long physicsUs = 0;
+static unsigned long long controlUs = 0;
+static bool inControlTick = false;
+static unsigned long long timeLimitUs = 0;
+
+static uint8_t pinLevel[NUM_PINS];
+static int pinPwm[NUM_PINS];
+static void (*pinIsr[NUM_PINS])(void);
+
+static Wheel leftWheel;
+static Wheel rightWheel;
+static SimPose pose;
+static bool colliding = false;
+static int collisionCount = 0;
+static float distanceDriven = 0;
+
+static std::mt19937 noiseSource;
+
+SimConfig defaultSimConfig() {
+  SimConfig c;
+  c.maxWheelSpeed_mm_s = 900;
+  c.batteryVoltage = BATTERY_NOMINAL_V;
+  c.motorTimeConstant_s = 0.05;
+  c.motorDeadband = 20;
+  c.wheelScale = 1.0 / 1.02;
+  c.trackScale = 1.12;
+  c.tofRangingMs = 33;
+  c.tofNoise_mm = 2.0;
+  c.robotRadius_mm = 45;
+  c.wallThickness_mm = 12;
+  c.callCost_us = 5;
+  c.serialOutput = false;
+  c.seed = 1;
+  return c;
+}
+
+static void addWall(float x0, float y0, float x1, float y1) {
+  float half = config.wallThickness_mm / 2;
+  WallBox box = {x0 - half, y0 - half, x1 + half, y1 + half};
+  wallBoxes.push_back(box);
+}
+
+static void buildWalls() {
+  const float c = CELL_SIZE_MM;
+  wallBoxes.clear();
+  for (int y = 0; y <= maze->rows; y++) {
+    for (int x = 0; x < maze->cols; x++) {
+      // South edge of (x, y), or the north boundary for y == rows
+      bool wall = (y < maze->rows) ? maze->hasWall(x, y, 2) : maze->hasWall(x, y - 1, 0);
+      if (wall) addWall(x * c, y * c, (x + 1) * c, y * c);
+    }
+  }
+  for (int x = 0; x <= maze->cols; x++) {
+    for (int y = 0; y < maze->rows; y++) {
+      // West edge of (x, y), or the east boundary for x == cols
+      bool wall = (x < maze->cols) ? maze->hasWall(x, y, 3) : maze->hasWall(x - 1, y, 1);
+      if (wall) addWall(x * c, y * c, x * c, (y + 1) * c);
+    }
+  }
+}
+
+static void resetWheel(Wheel& wheel, int pin1, int pin2, int pinA, int pinB) {
+  wheel.pin1 = pin1;
+  wheel.pin2 = pin2;
+  wheel.pinA = pinA;
+  wheel.pinB = pinB;
+  wheel.speed = 0;
+  wheel.travel = 0;
+  wheel.counts = 0;
+}
+
+void simInit(const SimMaze& simMaze, const SimConfig& simConfig, int startX, int startY) {
+  config = simConfig;
+  maze = &simMaze;
+  buildWalls();
+
+  nowUs = 0;
+  physicsUs = 0;
+  controlUs = 0;
+  timeLimitUs = 0;
+  memset(pinLevel, 0, sizeof(pinLevel));
+  memset(pinPwm, 0, sizeof(pinPwm));
+  memset(pinIsr, 0, sizeof(pinIsr));
+
+  resetWheel(leftWheel, LEFT_MOTOR_PIN1, LEFT_MOTOR_PIN2, ENCODER_LEFT_A, ENCODER_LEFT_B);
+  resetWheel(rightWheel, RIGHT_MOTOR_PIN1, RIGHT_MOTOR_PIN2, ENCODER_RIGHT_A, ENCODER_RIGHT_B);
+
+  pose.x = (startX + 0.5f) * CELL_SIZE_MM;
+  pose.y = (startY + 0.5f) * CELL_SIZE_MM;
+  pose.heading = PI / 2;
+  colliding = false;
+  collisionCount = 0;
+  distanceDriven = 0;
+
+  noiseSource.seed(config.seed);
+}
+
+static bool collides(float x, float y) {
+  float r2 = config.robotRadius_mm * config.robotRadius_mm;
+  for (size_t i = 0; i < wallBoxes.size(); i++) {
+    const WallBox& b = wallBoxes[i];
+    float dx = x - constrain(x, b.x0, b.x1);
+    float dy = y - constrain(y, b.y0, b.y1);
+    if (dx * dx + dy * dy < r2) return true;
+  }
+  return false;
+}
+
+float simRayCast(float x, float y, float heading) {
+  float dirX = cos(heading);
+  float dirY = sin(heading);
+  float nearest = -1;
+
+  // Slab test against every wall block
+  for (size_t i = 0; i < wallBoxes.size(); i++) {
+    const WallBox& b = wallBoxes[i];
+    float tNear = 0;
+    float tFar = 1e9;
+    float lo[2] = {b.x0, b.y0};
+    float hi[2] = {b.x1, b.y1};
+    float origin[2] = {x, y};
+    float dir[2] = {dirX, dirY};
+    bool hit = true;
+
+    for (int axis = 0; axis < 2 && hit; axis++) {
+      if (fabs(dir[axis]) < 1e-9) {
+        hit = origin[axis] >= lo[axis] && origin[axis] <= hi[axis];
+        continue;
+      }
+      float t0 = (lo[axis] - origin[axis]) / dir[axis];
+      float t1 = (hi[axis] - origin[axis]) / dir[axis];
+      if (t0 > t1) std::swap(t0, t1);
+      tNear = max(tNear, t0);
+      tFar = min(tFar, t1);
+      hit = tNear <= tFar;
+    }
+
+    if (hit && (nearest < 0 || tNear < nearest)) {
+      nearest = tNear;
+    }
+  }
+  return nearest;
+}
+
+// Emit quadrature edges until the count matches the wheel travel
+static void updateEncoder(Wheel& wheel) {
+  // Forward sequence of (A, B) states that the ISR decodes as +1
+  static const uint8_t forward[4] = {0x0, 0x2, 0x3, 0x1};
+  long target = lround(wheel.travel * COUNTS_PER_MM);
+
+  while (wheel.counts != target) {
+    uint8_t before = forward[wheel.counts & 3];
+    wheel.counts += (target > wheel.counts) ? 1 : -1;
+    uint8_t after = forward[wheel.counts & 3];
+
+    // Exactly one channel changes per edge
+    int pin = ((before ^ after) & 0x2) ? wheel.pinA : wheel.pinB;
+    pinLevel[wheel.pinA] = (after >> 1) & 1;
+    pinLevel[wheel.pinB] = after & 1;
+    if (pinIsr[pin]) pinIsr[pin]();
+  }
+}
+
+static void stepWheel(Wheel& wheel, float dt) {
+  int command = pinPwm[wheel.pin1] - pinPwm[wheel.pin2];
+  float target = (abs(command) < config.motorDeadband) ? 0 : command / 255.0f * config.maxWheelSpeed_mm_s;
+  if (config.batteryVoltage > 0) target *= config.batteryVoltage / BATTERY_NOMINAL_V;
+  wheel.speed += (target - wheel.speed) * min(1.0f, dt / config.motorTimeConstant_s);
+  wheel.travel += wheel.speed * dt;
+}
+
+static void stepPhysics(float dt) {
+  stepWheel(leftWheel, dt);
+  stepWheel(rightWheel, dt);
+
+  // Ground motion from the wheel speeds, with slip and scrub
+  float v = (leftWheel.speed + rightWheel.speed) / 2 * config.wheelScale;
+  float w = (rightWheel.speed - leftWheel.speed) / (WHEEL_BASE * config.trackScale);
+  float midHeading = pose.heading + w * dt / 2;
+  float nextX = pose.x + v * cos(midHeading) * dt;
+  float nextY = pose.y + v * sin(midHeading) * dt;
+  pose.heading += w * dt;
+
+  // Wheels keep turning against a wall, the robot does not move
+  if (collides(nextX, nextY)) {
+    if (!colliding) collisionCount++;
+    colliding = true;
+  } else {
+    distanceDriven += fabs(v) * dt;
+    pose.x = nextX;
+    pose.y = nextY;
+    colliding = false;
+  }
+
+  updateEncoder(leftWheel);
+  updateEncoder(rightWheel);
+}
+
+// The firmware's control task, on its own core: its calls take no time
+// on the main clock. A replay feeds recorded inputs to the motion code
+// and has no wheels to control
+static void runControlTick() {
+  if (!isControlLoopRunning() || getTraceMode() == TRACE_REPLAY) return;
+  inControlTick = true;
+  controlTick();
+  inControlTick = false;
+}
+
+void simAdvance(unsigned long us) {
+  if (inControlTick) return;
+
+  nowUs += us;
+  while (physicsUs + PHYSICS_STEP_US <= nowUs) {
+    physicsUs += PHYSICS_STEP_US;
+    stepPhysics(PHYSICS_STEP_US / 1e6f);
+
+    if (physicsUs >= controlUs + CONTROL_PERIOD_MS * 1000UL) {
+      controlUs += CONTROL_PERIOD_MS * 1000UL;
+      runControlTick();
+    }
+  }
+
+  if (timeLimitUs && nowUs >= timeLimitUs) {
+    throw SimTimeout();
+  }
+}
+
+void simSetTimeLimit(unsigned long long limit_us) {
+  timeLimitUs = limit_us;
+}
+
+unsigned long long simTimeMicros() {
+  return nowUs;
+}
+
+SimPose simGetPose() {
+  return pose;
+}
+
+int simGetCollisionCount() {
+  return collisionCount;
+}
+
+float simGetDistanceDriven() {
+  return distanceDriven;
+}
+
+void simGetMotorCommands(int* left, int* right) {
+  *left = pinPwm[leftWheel.pin1] - pinPwm[leftWheel.pin2];
+  *right = pinPwm[rightWheel.pin1] - pinPwm[rightWheel.pin2];
+}
+
+// ================== Arduino core ==================
+
+unsigned long millis() {
+  simAdvance(config.callCost_us);
+  return (unsigned long)(nowUs / 1000);
+}
+
+unsigned long micros() {
+  simAdvance(config.callCost_us);
+  return (unsigned long)nowUs;
+}
+
+void delay(unsigned long ms) {
+  simAdvance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  simAdvance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < NUM_PINS) pinLevel[pin] = value ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < NUM_PINS) ? pinLevel[pin] : LOW;
+}
+
+void analogWrite(uint8_t pin, int value) {
+  if (pin < NUM_PINS) pinPwm[pin] = constrain(value, 0, 255);
+  simAdvance(config.callCost_us);
+}
+
+int analogRead(uint8_t pin) {
+  return 0;
+}
+
+uint32_t analogReadMilliVolts(uint8_t pin) {
+  if (pin != BATTERY_ADC_PIN) return 0;
+  return (uint32_t)lround(config.batteryVoltage * 1000 / BATTERY_DIVIDER_RATIO);
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  if (pin < NUM_PINS) pinIsr[pin] = isr;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < NUM_PINS) pinIsr[pin] = NULL;
+}
+
+void simSerialWrite(const char* text) {
+  if (config.serialOutput) fputs(text, stdout);
+}
+
+// ================== VL53L0X ==================
+
+void Adafruit_VL53L0X::rangingTest(VL53L0X_RangingMeasurementData_t* measure, bool debug) {
+  // The reading describes the end of the timing budget
+  simAdvance(config.tofRangingMs * 1000UL);
+
+  float forwardOffset = 0;
+  float sideOffset = 0;
+  float beam = 0;
+  if (address == ADDR_CENTER) {
+    forwardOffset = FRONT_SENSOR_OFFSET_MM;
+  } else if (address == ADDR_LEFT) {
+    sideOffset = SIDE_SENSOR_OFFSET_MM;
+    beam = PI / 2;
+  } else {
+    sideOffset = -SIDE_SENSOR_OFFSET_MM;
+    beam = -PI / 2;
+  }
+
+  float c = cos(pose.heading);
+  float s = sin(pose.heading);
+  float sensorX = pose.x + forwardOffset * c - sideOffset * s;
+  float sensorY = pose.y + forwardOffset * s + sideOffset * c;
+
+  float distance = simRayCast(sensorX, sensorY, pose.heading + beam);
+  if (distance >= 0 && config.tofNoise_mm > 0) {
+    std::normal_distribution<float> noise(0, config.tofNoise_mm);
+    distance += noise(noiseSource);
+  }
+
+  if (distance < 0 || distance > TOF_MAX_RANGE_MM) {
+    measure->RangeMilliMeter = 8190;
+    measure->RangeStatus = 4;
+  } else {
+    measure->RangeMilliMeter = (uint16_t)max(0.0f, distance);
+    measure->RangeStatus = 0;
+  }
+}
+
+// ================== Preferences ==================
+
+static std::map<std::string, std::vector<uint8_t> >& preferenceStore() {
+  static std::map<std::string, std::vector<uint8_t> > store;
+  return store;
+}
+
+bool Preferences::begin(const char* name, bool readOnlyMode) {
+  space = std::string(name) + "/";
+  readOnly = readOnlyMode;
+  return true;
+}
+
+void Preferences::end() {
+  space.clear();
+}
+
+bool Preferences::clear() {
+  if (readOnly) return false;
+  std::map<std::string, std::vector<uint8_t> >& store = preferenceStore();
+  for (std::map<std::string, std::vector<uint8_t> >::iterator it = store.begin(); it != store.end();) {
+    if (it->first.compare(0, space.size(), space) == 0) store.erase(it++);
+    else ++it;
+  }
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  return !readOnly && preferenceStore().erase(space + key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  return preferenceStore().count(space + key) > 0;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  std::map<std::string, std::vector<uint8_t> >::iterator it = preferenceStore().find(space + key);
+  return (it == preferenceStore().end()) ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+  std::map<std::string, std::vector<uint8_t> >::iterator it = preferenceStore().find(space + key);
+  if (it == preferenceStore().end() || it->second.size() > length) return 0;
+  memcpy(buffer, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+  if (readOnly) return 0;
+  const uint8_t* bytes = (const uint8_t*)value;
+  preferenceStore()[space + key].assign(bytes, bytes + length);
+  return length;
+}
+
+float Preferences::getFloat(const char* key, float defaultValue) {
+  float value = defaultValue;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+size_t Preferences::putFloat(const char* key, float value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+  uint32_t value = defaultValue;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
@@ -0,0 +1,98 @@
+#ifndef SIM_HARDWARE_H
+#define SIM_HARDWARE_H
+
+/**
+ * @brief Simulated Hardware Module
+ *
+ * Closed-loop stand-in for the robot behind the Arduino shims:
+ * - Simulated clock: millis()/micros()/delay() and every ToF ranging
+ *   advance it; physics runs in fixed steps as time passes, and the
+ *   firmware's control loop ticks every CONTROL_PERIOD_MS
+ * - Differential-drive model driven by the motor PWM pins (setMotors())
+ *   with a first-order motor response, scaled by the battery voltage
+ *   that the battery ADC pin reports through the divider
+ * - Quadrature encoder edges on the encoder pins, decoded by the
+ *   firmware's own interrupt service routines
+ * - ToF distances ray-cast against the walls of the loaded maze
+ * - Collision detection against the walls
+ *
+ * Coordinates are millimetres with (0, 0) at the south-west corner of
+ * the maze; heading is in radians, counter-clockwise from east.
+ */
+
+#include "SimMaze.h"
+#include <stdint.h>
+
+struct SimConfig {
+  float maxWheelSpeed_mm_s;  // Wheel speed at PWM 255 and BATTERY_NOMINAL_V
+  float batteryVoltage;      // Pack voltage; wheel speed scales with it (0 = not measured)
+  float motorTimeConstant_s; // First-order motor response
+  int motorDeadband;         // PWM below this does not turn the wheel
+  float wheelScale;          // Actual/nominal wheel travel (slip, tyre wear)
+  float trackScale;          // Effective/nominal wheelbase in turns (scrub)
+  int tofRangingMs;          // Time one rangingTest() takes
+  float tofNoise_mm;         // Standard deviation of ToF readings
+  float robotRadius_mm;      // Collision circle around the robot center
+  float wallThickness_mm;
+  unsigned long callCost_us; // Time charged per millis()/analogWrite() call
+  bool serialOutput;         // Echo the firmware's Serial output
+  unsigned int seed;         // Noise seed
+};
+
+struct SimPose {
+  float x;
+  float y;
+  float heading;
+};
+
+/**
+ * @brief Default parameters, roughly matching the robot
+ * The wheel and track scales reproduce the 1.02 / 1.12 correction
+ * factors the firmware was tuned with
+ */
+SimConfig defaultSimConfig();
+
+/**
+ * @brief Reset the simulated world
+ * Time restarts at zero and the robot stands in the center of cell
+ * (startX, startY) facing north
+ * @param maze Ground-truth maze (kept by reference)
+ * @param config Simulation parameters
+ * @param startX Start cell X coordinate
+ * @param startY Start cell Y coordinate
+ */
+void simInit(const SimMaze& maze, const SimConfig& config, int startX = 0, int startY = 0);
+
+/**
+ * @brief Advance simulated time, stepping the physics
+ * @param us Microseconds to advance
+ */
+void simAdvance(unsigned long us);
+
+/**
+ * @brief Stop the run by throwing SimTimeout once this time is reached
+ * Checked whenever simulated time advances, so firmware loops that
+ * never return still end
+ * @param limit_us Simulated time limit in microseconds (0 = none)
+ */
+void simSetTimeLimit(unsigned long long limit_us);
+
+struct SimTimeout {};
+
+// Simulation state for reports and tools
+unsigned long long simTimeMicros();
+SimPose simGetPose();
+int simGetCollisionCount();
+float simGetDistanceDriven();
+void simGetMotorCommands(int* left, int* right);
+
+/**
+ * @brief Distance from a sensor to the nearest wall along its beam
+ * @param x Sensor position X (mm)
+ * @param y Sensor position Y (mm)
+ * @param heading Beam direction (radians)
+ * @return Distance in mm, or a negative value if nothing is hit
+ */
+float simRayCast(float x, float y, float heading);
+
+#endif // SIM_HARDWARE_H
@@ -0,0 +1,87 @@
+#include "SimMaze.h"
+#include <fstream>
+#include <sstream>
+
+static bool fail(std::string* error, const std::string& message) {
+  if (error) *error = message;
+  return false;
+}
+
+static char charAt(const std::string& line, size_t column) {
+  return column < line.size() ? line[column] : ' ';
+}
+
+bool parseSimMaze(const std::string& text, SimMaze& maze, std::string* error) {
+  // Keep the drawing lines only (posts start every other line)
+  std::vector<std::string> lines;
+  std::istringstream in(text);
+  std::string line;
+  while (std::getline(in, line)) {
+    while (!line.empty() && (line[line.size() - 1] == '\r' || line[line.size() - 1] == ' ')) {
+      line.erase(line.size() - 1);
+    }
+    if (!line.empty()) lines.push_back(line);
+  }
+
+  if (lines.size() < 3 || lines.size() % 2 == 0) {
+    return fail(error, "expected an odd number of post and cell lines");
+  }
+  if (lines[0].size() < 5 || (lines[0].size() - 1) % 4 != 0) {
+    return fail(error, "first line is not a row of posts");
+  }
+
+  maze.rows = (int)(lines.size() - 1) / 2;
+  maze.cols = (int)(lines[0].size() - 1) / 4;
+  maze.walls.assign(maze.rows * maze.cols, 0);
+
+  // Line 0 is the north boundary; row k of cells is drawn on line 2k+1
+  // with its south edges on line 2k+2, from the north row downwards
+  for (int k = 0; k < maze.rows; k++) {
+    int y = maze.rows - 1 - k;
+    const std::string& north = lines[2 * k];
+    const std::string& cells = lines[2 * k + 1];
+    const std::string& south = lines[2 * k + 2];
+
+    for (int x = 0; x < maze.cols; x++) {
+      uint8_t mask = 0;
+      if (charAt(north, 4 * x + 2) == '-') mask |= 1;
+      if (charAt(cells, 4 * x + 4) == '|') mask |= 2;
+      if (charAt(south, 4 * x + 2) == '-') mask |= 4;
+      if (charAt(cells, 4 * x) == '|') mask |= 8;
+      maze.walls[y * maze.cols + x] = mask;
+    }
+  }
+
+  // Both sides of an edge must agree and the boundary must be closed
+  for (int y = 0; y < maze.rows; y++) {
+    for (int x = 0; x < maze.cols; x++) {
+      if (x == 0 && !maze.hasWall(x, y, 3)) return fail(error, "west boundary is open");
+      if (x == maze.cols - 1 && !maze.hasWall(x, y, 1)) return fail(error, "east boundary is open");
+      if (y == 0 && !maze.hasWall(x, y, 2)) return fail(error, "south boundary is open");
+      if (y == maze.rows - 1 && !maze.hasWall(x, y, 0)) return fail(error, "north boundary is open");
+    }
+  }
+  return true;
+}
+
+bool loadSimMaze(const char* path, SimMaze& maze, std::string* error) {
+  std::ifstream file(path);
+  if (!file) {
+    return fail(error, std::string("cannot open ") + path);
+  }
+
+  std::stringstream text;
+  text << file.rdbuf();
+  if (!parseSimMaze(text.str(), maze, error)) {
+    return false;
+  }
+
+  // File name without directories and extension
+  std::string name = path;
+  size_t slash = name.find_last_of('/');
+  if (slash != std::string::npos) name = name.substr(slash + 1);
+  size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos) name = name.substr(0, dot);
+  maze.name = name;
+  return true;
+}
@@ -0,0 +1,50 @@
+#ifndef SIM_MAZE_H
+#define SIM_MAZE_H
+
+/**
+ * @brief Simulator Maze Module
+ *
+ * The ground-truth maze the simulated robot drives in:
+ * - Loads the classic ASCII maze format ('o' posts, '---' and '|' walls,
+ *   north row first) used by the public micromouse maze collections
+ * - Answers wall queries in the firmware's cell and direction convention
+ *   (x east, y north, 0=North 1=East 2=South 3=West)
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct SimMaze {
+  int rows;
+  int cols;
+  std::vector<uint8_t> walls; // Per cell: bit0=N, bit1=E, bit2=S, bit3=W
+  std::string name;
+
+  SimMaze() : rows(0), cols(0) {}
+
+  bool hasWall(int x, int y, int direction) const {
+    if (x < 0 || x >= cols || y < 0 || y >= rows) return true;
+    return (walls[y * cols + x] >> direction) & 1;
+  }
+};
+
+/**
+ * @brief Load a maze in the classic ASCII format
+ * @param path Maze file
+ * @param maze Output maze
+ * @param error Optional output: reason the file was rejected
+ * @return true if the file was a well-formed maze
+ */
+bool loadSimMaze(const char* path, SimMaze& maze, std::string* error = NULL);
+
+/**
+ * @brief Parse a maze in the classic ASCII format from text
+ * @param text File contents
+ * @param maze Output maze
+ * @param error Optional output: reason the text was rejected
+ * @return true if the text was a well-formed maze
+ */
+bool parseSimMaze(const std::string& text, SimMaze& maze, std::string* error = NULL);
+
+#endif // SIM_MAZE_H
@@ -0,0 +1,19 @@
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+/**
+ * @brief I2C shim for the host simulator
+ * The simulated sensors do not talk over a bus; begin() only succeeds
+ */
+
+#include <stdint.h>
+
+class TwoWire {
+public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+  void setClock(uint32_t frequency) {}
+};
+
+extern TwoWire Wire;
+
+#endif // SIM_WIRE_H
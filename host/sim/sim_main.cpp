@@ -0,0 +1,172 @@
+/**
+ * @file sim_main.cpp
+ * @brief Run the unchanged firmware against the simulated robot
+ *
+ * Calls the sketch's setup() and loop() with the Arduino shims in this
+ * directory, so MazeNavigation, Movement, Odometry and Mission run
+ * closed-loop on simulated motors, encoders and ToF sensors in a maze
+ * loaded from a file. The run ends after the requested number of speed
+ * runs or when the simulated time limit is reached.
+ *
+ * The run fails (exit code 1) if the time limit was reached, the robot
+ * hit a wall, the learned map has a wrong wall, the firmware believes
+ * it is in a different cell than the simulated robot, or a streaming
+ * search never sampled a cell's walls while moving into it or never
+ * took a turn on an arc.
+ *
+ * With --trace the run is recorded like on the robot and written to a
+ * file that replay_trace can play back. --trace-size gives it the
+ * robot's buffer size instead of room for the whole run.
+ *
+ * Usage: mouse_sim [-v] [-t seconds] [-r runs] [--tof-ms ms] [--seed n]
+ *                  [--battery volts] [--trace file] [--trace-size n] maze.txt
+ */
+
+#include "SimHardware.h"
+#include "SimMaze.h"
+#include "MazeNavigation.h"
+#include "Mission.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// The sketch (duck.ino)
+void setup();
+void loop();
+
+static void usage() {
+  fprintf(stderr,
+          "usage: mouse_sim [options] maze.txt\n"
+          "  -v            echo the firmware's Serial output\n"
+          "  -t seconds    simulated time limit (default 600)\n"
+          "  -r runs       stop after this many speed runs (default 1)\n"
+          "  --tof-ms ms   duration of one ToF ranging (default 33)\n"
+          "  --seed n      sensor noise seed (default 1)\n"
+          "  --battery V   battery pack voltage (default BATTERY_NOMINAL_V)\n"
+          "  --trace file  record a run trace into file\n"
+          "  --trace-size n  trace buffer bytes, the oldest records are dropped\n"
+          "                when it is full (default: room for the whole run)\n");
+}
+
+// Known edges of the learned map that disagree with the real maze
+static int countWrongWalls(const SimMaze& maze, int* knownEdges) {
+  int wrong = 0;
+  *knownEdges = 0;
+  for (int y = 0; y < MAZE_ROWS; y++) {
+    for (int x = 0; x < MAZE_COLS; x++) {
+      // North and east edges cover every interior edge once
+      for (int d = 0; d < 2; d++) {
+        if (!isWallKnown(x, y, d)) continue;
+        (*knownEdges)++;
+        if (hasWall(x, y, d) != maze.hasWall(x, y, d)) wrong++;
+      }
+    }
+  }
+  return wrong;
+}
+
+int main(int argc, char** argv) {
+  SimConfig config = defaultSimConfig();
+  double timeLimit = 600;
+  int targetRuns = 1;
+  const char* mazePath = NULL;
+  const char* tracePath = NULL;
+  size_t traceSize = 64 << 20;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-v")) config.serialOutput = true;
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) timeLimit = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc) targetRuns = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--tof-ms") && i + 1 < argc) config.tofRangingMs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) config.seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--battery") && i + 1 < argc) config.batteryVoltage = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--trace") && i + 1 < argc) tracePath = argv[++i];
+    else if (!strcmp(argv[i], "--trace-size") && i + 1 < argc) traceSize = atol(argv[++i]);
+    else if (argv[i][0] != '-' && !mazePath) mazePath = argv[i];
+    else { usage(); return 2; }
+  }
+  if (!mazePath) { usage(); return 2; }
+
+  SimMaze maze;
+  std::string error;
+  if (!loadSimMaze(mazePath, maze, &error)) {
+    fprintf(stderr, "%s: %s\n", mazePath, error.c_str());
+    return 2;
+  }
+  if (maze.rows != MAZE_ROWS || maze.cols != MAZE_COLS) {
+    fprintf(stderr, "%s: maze is %dx%d, firmware is built for %dx%d\n",
+            mazePath, maze.cols, maze.rows, MAZE_COLS, MAZE_ROWS);
+    return 2;
+  }
+
+  simInit(maze, config);
+  simSetTimeLimit((unsigned long long)(timeLimit * 1e6));
+
+  // Room for a whole run; setup() keeps a recording that is already running
+  std::vector<uint8_t> traceBuffer;
+  if (tracePath) {
+    traceBuffer.resize(traceSize);
+    startTraceRecording(traceBuffer.data(), traceBuffer.size());
+  }
+
+  auto wallStart = std::chrono::steady_clock::now();
+  bool timedOut = false;
+  try {
+    setup();
+    while (getSpeedRunCount() < targetRuns && getMissionPhase() != PHASE_STOPPED) {
+      loop();
+    }
+  } catch (const SimTimeout&) {
+    timedOut = true;
+  }
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  double simSeconds = simTimeMicros() / 1e6;
+
+  int knownEdges = 0;
+  int wrongWalls = countWrongWalls(maze, &knownEdges);
+  SimPose pose = simGetPose();
+  int actualX = (int)(pose.x / CELL_SIZE_MM);
+  int actualY = (int)(pose.y / CELL_SIZE_MM);
+  int collisions = simGetCollisionCount();
+  bool lost = currentX != actualX || currentY != actualY;
+  SearchStats search = getSearchStats();
+  bool neverSampled = streamingSearch && search.sampledCells == 0;
+  bool neverArced = streamingSearch && search.arcTurns == 0;
+  bool stopped = getMissionPhase() == PHASE_STOPPED;
+  bool failed = timedOut || stopped || collisions > 0 || wrongWalls > 0 || lost || neverSampled || neverArced;
+
+  if (tracePath) {
+    size_t length = 0;
+    const uint8_t* data = getTraceData(&length);
+    FILE* file = fopen(tracePath, "wb");
+    if (!file || fwrite(data, 1, length, file) != length) {
+      fprintf(stderr, "%s: cannot write trace\n", tracePath);
+    }
+    if (file) fclose(file);
+  }
+
+  printf("maze:            %s\n", maze.name.c_str());
+  printf("result:          %s\n", failed ? "FAILED" : "speed runs completed");
+  if (timedOut) printf("  time limit reached\n");
+  if (stopped) printf("  mission stopped, target unreachable\n");
+  if (collisions > 0) printf("  robot hit a wall\n");
+  if (wrongWalls > 0) printf("  learned map has wrong walls\n");
+  if (lost) printf("  believed cell differs from the actual cell\n");
+  if (neverSampled) printf("  no walls sampled while moving\n");
+  if (neverArced) printf("  no turns taken on an arc\n");
+  printf("speed runs:      %d\n", getSpeedRunCount());
+  printf("simulated time:  %.2f s\n", simSeconds);
+  printf("wall-clock time: %.3f s (%.0fx real time)\n", wallSeconds, simSeconds / std::max(wallSeconds, 1e-6));
+  printf("distance driven: %.0f mm\n", simGetDistanceDriven());
+  printf("collisions:      %d\n", collisions);
+  printf("known edges:     %d (%d wrong)\n", knownEdges, wrongWalls);
+  printf("search cells:    %d sampled while moving, %d scanned\n", search.sampledCells, search.scannedCells);
+  printf("search turns:    %d on an arc, %d pivots\n", search.arcTurns, search.pivotTurns);
+  printf("believed cell:   (%d, %d)\n", currentX, currentY);
+  printf("actual cell:     (%d, %d)\n", actualX, actualY);
+  return failed ? 1 : 0;
+}